@@ -0,0 +1,115 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Hardware abstraction layer for GPIO and timing
+// ----------------------------------------------------------------------------
+
+#ifndef __HAL_H__
+#define __HAL_H__
+
+// The sensor drivers only talk to the hardware through these functions.
+// On the ESP32 they map 1:1 onto the Arduino core, in the native (host)
+// build they drive the simulated GPIO bus from lib/sim, which runs on a
+// virtual clock and hosts software models of the sensors.
+
+#ifdef ARDUINO
+
+#include "Arduino.h"
+
+inline void hal_pin_mode(uint8_t pin, uint8_t mode) { pinMode(pin, mode); }
+inline void hal_write(uint8_t pin, uint8_t level) { digitalWrite(pin, level); }
+inline int hal_read(uint8_t pin) { return digitalRead(pin); }
+inline void hal_delay_us(uint32_t us) { delayMicroseconds(us); }
+inline void hal_delay_ms(uint32_t ms) { delay(ms); }
+inline unsigned long hal_micros() { return micros(); }
+inline unsigned long hal_millis() { return millis(); }
+
+#include "esp_sleep.h"
+
+// light sleep: CPU, RAM and peripherals keep their state, wake up by timer
+inline void hal_light_sleep_us(uint32_t us)
+{
+  esp_sleep_enable_timer_wakeup(us);
+  esp_light_sleep_start();
+}
+
+#include "soc/gpio_struct.h"
+
+// CPU cycle counter (CCOUNT special register)
+inline uint32_t hal_cycles()
+{
+  uint32_t c;
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(c));
+  return c;
+}
+
+// busy wait counted in CPU cycles, for the sub-microsecond gaps
+// that delayMicroseconds() can not express
+inline void hal_delay_ns(uint32_t ns)
+{
+  uint32_t cycles = ns * (F_CPU / 1000000) / 1000;
+  uint32_t start = hal_cycles();
+  while (hal_cycles() - start < cycles) {}
+}
+
+// Pin-specialized GPIO access through the W1TS/W1TC set/clear registers,
+// a single store instead of a digitalWrite() call. The pin has to be set
+// up once with hal_pin_mode() so it is routed to the GPIO matrix.
+template <uint8_t PIN>
+struct HalPin {
+  static inline void high() {
+    if (PIN < 32) GPIO.out_w1ts = 1UL << (PIN & 31);
+    else GPIO.out1_w1ts.val = 1UL << (PIN & 31);
+  }
+  static inline void low() {
+    if (PIN < 32) GPIO.out_w1tc = 1UL << (PIN & 31);
+    else GPIO.out1_w1tc.val = 1UL << (PIN & 31);
+  }
+  static inline void write(bool level) { if (level) high(); else low(); }
+  static inline int read() {
+    if (PIN < 32) return (GPIO.in >> (PIN & 31)) & 1;
+    return (GPIO.in1.val >> (PIN & 31)) & 1;
+  }
+  static inline void output() {
+    if (PIN < 32) GPIO.enable_w1ts = 1UL << (PIN & 31);
+    else GPIO.enable1_w1ts.val = 1UL << (PIN & 31);
+  }
+  static inline void input() {
+    if (PIN < 32) GPIO.enable_w1tc = 1UL << (PIN & 31);
+    else GPIO.enable1_w1tc.val = 1UL << (PIN & 31);
+  }
+};
+
+#else
+
+#include "HostArduino.h"
+
+void hal_pin_mode(uint8_t pin, uint8_t mode);
+void hal_write(uint8_t pin, uint8_t level);
+int hal_read(uint8_t pin);
+void hal_delay_us(uint32_t us);
+void hal_delay_ms(uint32_t ms);
+unsigned long hal_micros();
+unsigned long hal_millis();
+void hal_light_sleep_us(uint32_t us);
+
+uint32_t hal_cycles();
+void hal_delay_ns(uint32_t ns);
+
+// register-level pin access, simulated with its own (lower) per-call cost
+void hal_fast_write(uint8_t pin, uint8_t level);
+int hal_fast_read(uint8_t pin);
+void hal_fast_mode(uint8_t pin, uint8_t mode);
+
+template <uint8_t PIN>
+struct HalPin {
+  static inline void high() { hal_fast_write(PIN, HIGH); }
+  static inline void low() { hal_fast_write(PIN, LOW); }
+  static inline void write(bool level) { hal_fast_write(PIN, level ? HIGH : LOW); }
+  static inline int read() { return hal_fast_read(PIN); }
+  static inline void output() { hal_fast_mode(PIN, OUTPUT); }
+  static inline void input() { hal_fast_mode(PIN, INPUT); }
+};
+
+#endif
+
+#endif  // __HAL_H__
@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Minimal Arduino core replacement for the native (host) build
+// ----------------------------------------------------------------------------
+
+#include "HostArduino.h"
+#include <stdio.h>
+
+HostSerial Serial;
+
+void HostSerial::print(const char *s)
+{
+  fputs(s, stdout);
+}
+
+void HostSerial::print(char c)
+{
+  fputc(c, stdout);
+}
+
+void HostSerial::print(long n, int base)
+{
+  if (n < 0 && base == DEC) {
+    fputc('-', stdout);
+    print((unsigned long)-n, base);
+  } else {
+    print((unsigned long)n, base);
+  }
+}
+
+void HostSerial::print(unsigned long n, int base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+  *p = 0;
+
+  if (base < 2) base = 10;
+  do {
+    int d = n % base;
+    *--p = d < 10 ? '0' + d : 'A' + d - 10;
+    n /= base;
+  } while (n);
+
+  fputs(p, stdout);
+}
+
+void HostSerial::print(double d, int digits)
+{
+  printf("%.*f", digits, d);
+}
+
+void HostSerial::println()
+{
+  fputs("\r\n", stdout);
+}
+
+void HostSerial::write(const uint8_t *buf, size_t len)
+{
+  fwrite(buf, 1, len, stdout);
+}
+
+void HostSerial::flush()
+{
+  fflush(stdout);
+}
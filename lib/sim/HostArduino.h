@@ -0,0 +1,56 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Minimal Arduino core replacement for the native (host) build
+// ----------------------------------------------------------------------------
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// only what the drivers need besides the GPIO/timing functions in hal.h
+
+#define LOW     0
+#define HIGH    1
+#define INPUT   0x01
+#define OUTPUT  0x02
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// Serial replacement writing to stdout
+class HostSerial {
+  public:
+    void begin(unsigned long) {}
+
+    void print(const char *s);
+    void print(char c);
+    void print(long n, int base = DEC);
+    void print(unsigned long n, int base = DEC);
+    void print(int n, int base = DEC) { print((long)n, base); }
+    void print(unsigned int n, int base = DEC) { print((unsigned long)n, base); }
+    void print(uint8_t n, int base = DEC) { print((unsigned long)n, base); }
+    void print(int8_t n, int base = DEC) { print((long)n, base); }
+    void print(double d, int digits = 2);
+
+    template <typename T>
+    void println(T v) { print(v); println(); }
+    template <typename T>
+    void println(T v, int fmt) { print(v, fmt); println(); }
+    void println();
+
+    void write(const uint8_t *buf, size_t len);
+    void flush();
+};
+
+extern HostSerial Serial;
+
+#endif  // __HOST_ARDUINO_H__
@@ -0,0 +1,255 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Software model of the ADNS-5020 serial port (native build)
+// ----------------------------------------------------------------------------
+
+#include "SimADNS5020.h"
+
+#define REG_PRODUCT_ID     0x00
+#define REG_REVISION_ID    0x01
+#define REG_MOTION         0x02
+#define REG_DELTA_X        0x03
+#define REG_DELTA_Y        0x04
+#define REG_SQUAL          0x05
+#define REG_SHUTTER_UPPER  0x06
+#define REG_SHUTTER_LOWER  0x07
+#define REG_MAX_PIXEL      0x08
+#define REG_PIXEL_SUM      0x09
+#define REG_PIXEL_GRAB     0x0b
+#define REG_CONTROL        0x0d
+#define REG_CHIP_RESET     0x3a
+#define REG_BURST_MODE     0x63
+
+static const uint8_t burst_order[] = {
+  REG_DELTA_X, REG_DELTA_Y, REG_SQUAL, REG_SHUTTER_UPPER,
+  REG_SHUTTER_LOWER, REG_MAX_PIXEL, REG_PIXEL_SUM
+};
+
+SimADNS5020::SimADNS5020(SimBus &bus, uint8_t sclk, uint8_t sdio, uint8_t ncs, uint8_t nreset)
+  : motion(500 / 25.4f), _bus(bus)
+{
+  _sclk = sclk;
+  _sdio = sdio;
+  _ncs = ncs;
+  _nreset = nreset;
+
+  squal = 40;
+  shutter = 0x0100;
+  for (int i = 0; i < SIM_ADNS5020_FRAME_LENGTH; ++i)
+    pixels[i] = (uint8_t)((i * 37 + (i / 15) * 11) & 0x7f);
+
+  // datasheet timing
+  t_srad_ns = 4000;
+  t_srx_ns = 500;
+  t_sww_ns = 30000;
+  t_swr_ns = 20000;
+  t_ncs_sclk_ns = 120;
+  t_hold_ns = 120;
+  t_frame_ns = 333000;
+  t_wakeup_ns = 55000000;
+
+  reads = writes = violations = control_writes = 0;
+  clocks = 0;
+
+  _selected = (_ncs == SIM_NO_PIN);
+  _sclk_level = _bus.level(_sclk);
+  _t_rise = 0;
+  _t_ready_read = _t_ready_write = 0;
+  _pix_index = 0;
+  _t_pix_ready = 0;
+  endTransfer();
+  chipReset(0);
+  _t_awake = 0;
+
+  _bus.attach(this);
+}
+
+SimADNS5020::~SimADNS5020()
+{
+  _bus.detach(this);
+}
+
+void SimADNS5020::check(uint64_t t_ns, uint64_t earliest)
+{
+  if (t_ns < earliest) ++violations;
+}
+
+void SimADNS5020::chipReset(uint64_t t_ns)
+{
+  control = 0;
+  _powered = true;
+  _latched = false;
+  _latch_x = _latch_y = 0;
+  _t_awake = t_ns + t_wakeup_ns;
+  motion.freeze(false, t_ns);
+  motion.setResolution(cpi() / 25.4f, t_ns);
+}
+
+void SimADNS5020::endTransfer()
+{
+  _state = ADDR;
+  _bits = 0;
+  _shift = 0;
+  _burst = false;
+  _burst_index = 0;
+}
+
+uint8_t SimADNS5020::readRegister(uint8_t addr, uint64_t t_ns)
+{
+  motion.update(t_ns);
+  bool valid = _powered && t_ns >= _t_awake;
+
+  switch (addr) {
+    case REG_PRODUCT_ID:
+      return 0x12;
+    case REG_REVISION_ID:
+      return 0x01;
+    case REG_MOTION:
+      if (!valid) return 0;
+      {
+        // (re)latch; counts latched earlier but not read are kept
+        if (_latched) motion.move(_latch_x, _latch_y, false);
+        uint8_t ovf = (motion.overflowY() ? 0x10 : 0) | (motion.overflowX() ? 0x08 : 0);
+        _latch_x = motion.takeX();
+        _latch_y = motion.takeY();
+        _latched = true;
+        return ((_latch_x || _latch_y) ? 0x80 : 0) | ovf;
+      }
+    case REG_DELTA_X: {
+      if (!valid) return 0;
+      int8_t v = _latched ? _latch_x : motion.takeX();
+      _latch_x = 0;
+      return (uint8_t)v;
+    }
+    case REG_DELTA_Y: {
+      if (!valid) return 0;
+      int8_t v = _latched ? _latch_y : motion.takeY();
+      _latch_y = 0;
+      _latched = false;
+      return (uint8_t)v;
+    }
+    case REG_SQUAL:
+      return valid ? squal : 0;
+    case REG_SHUTTER_UPPER:
+      return shutter >> 8;
+    case REG_SHUTTER_LOWER:
+      return shutter & 0xff;
+    case REG_MAX_PIXEL:
+      return 0x7f;
+    case REG_PIXEL_SUM:
+      return 0x40;
+    case REG_PIXEL_GRAB:
+      if (t_ns < _t_pix_ready) return 0;   // valid bit clear
+      {
+        uint8_t p = pixels[_pix_index];
+        if (++_pix_index == SIM_ADNS5020_FRAME_LENGTH) _pix_index = 0;
+        return 0x80 | p;
+      }
+    case REG_CONTROL:
+      return control;
+  }
+  return 0;
+}
+
+void SimADNS5020::writeRegister(uint8_t addr, uint8_t val, uint64_t t_ns)
+{
+  ++writes;
+  switch (addr) {
+    case REG_CONTROL:
+      ++control_writes;
+      control = val;
+      _powered = !(val & 0x02);
+      motion.freeze(!_powered, t_ns);
+      motion.setResolution(cpi() / 25.4f, t_ns);
+      break;
+    case REG_PIXEL_GRAB:
+      _pix_index = 0;
+      _t_pix_ready = t_ns + t_frame_ns;
+      break;
+    case REG_CHIP_RESET:
+      if (val == 0x5a) chipReset(t_ns);
+      break;
+  }
+}
+
+void SimADNS5020::pinChanged(uint8_t pin, int level, uint64_t t_ns)
+{
+  if (pin == _ncs) {
+    _selected = (level == LOW);
+    if (_selected) {
+      _t_rise = t_ns + t_ncs_sclk_ns;   // no SCLK edge before tNCS-SCLK
+    } else {
+      _bus.releaseAt(_sdio, t_ns + t_hold_ns);
+      endTransfer();
+    }
+    return;
+  }
+
+  if (pin == _nreset) {
+    if (level == HIGH) chipReset(t_ns);
+    return;
+  }
+
+  if (pin != _sclk) return;
+  int prev = _sclk_level;
+  _sclk_level = level;
+  if (!_selected || prev == level) return;
+
+  if (level == LOW) {
+    if (_state == RDATA) {
+      if (_bits == 0 && !(_burst && _burst_index > 0)) check(t_ns, _t_ready_read);
+      _bus.drive(_sdio, (_out & 0x80) ? HIGH : LOW);
+      _out <<= 1;
+    } else if (_state == ADDR && _bits == 0) {
+      check(t_ns, _t_rise);
+    }
+    return;
+  }
+
+  _t_rise = t_ns;
+  ++clocks;
+
+  switch (_state) {
+    case ADDR:
+      _shift = (_shift << 1) | (_bus.level(_sdio) ? 1 : 0);
+      if (++_bits < 8) break;
+      _bits = 0;
+      _addr = _shift & 0x7f;
+      if (_shift & 0x80) {
+        check(t_ns, _t_ready_write);
+        _state = WDATA;
+      } else {
+        check(t_ns, _t_ready_read);
+        _burst = (_addr == REG_BURST_MODE);
+        _burst_index = 0;
+        _out = readRegister(_burst ? burst_order[0] : _addr, t_ns);
+        _state = RDATA;
+        _t_ready_read = t_ns + t_srad_ns;
+      }
+      break;
+
+    case WDATA:
+      _shift = (_shift << 1) | (_bus.level(_sdio) ? 1 : 0);
+      if (++_bits < 8) break;
+      _bits = 0;
+      writeRegister(_addr, _shift, t_ns);
+      _state = ADDR;
+      _t_ready_write = t_ns + t_sww_ns;
+      _t_ready_read = t_ns + t_swr_ns;
+      break;
+
+    case RDATA:
+      if (++_bits < 8) break;
+      _bits = 0;
+      ++reads;
+      if (_burst && ++_burst_index < (int)sizeof(burst_order)) {
+        _out = readRegister(burst_order[_burst_index], t_ns);
+        break;
+      }
+      _bus.releaseAt(_sdio, t_ns + t_hold_ns);
+      _state = ADDR;
+      _burst = false;
+      _t_ready_read = _t_ready_write = t_ns + t_srx_ns;
+      break;
+  }
+}
@@ -0,0 +1,89 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Software model of the ADNS-5020 serial port (native build)
+// ----------------------------------------------------------------------------
+
+#ifndef __SIMADNS5020_H__
+#define __SIMADNS5020_H__
+
+#include "SimBus.h"
+#include "SimMotion.h"
+
+#define SIM_ADNS5020_FRAME_LENGTH 225
+#define SIM_NO_PIN 0xff
+
+// Three-wire SPI-like port (SCLK, SDIO, NCS): the chip samples SDIO on the
+// rising edge and shifts read data out on the falling edge. Address MSB=1
+// is a write. Reading MOTION freezes DELTA_X/DELTA_Y until they are read,
+// BURST_MODE streams the motion registers until NCS goes high.
+class SimADNS5020 : public SimDevice {
+  public:
+    SimADNS5020(SimBus &bus, uint8_t sclk, uint8_t sdio,
+                uint8_t ncs = SIM_NO_PIN, uint8_t nreset = SIM_NO_PIN);
+    ~SimADNS5020();
+
+    void pinChanged(uint8_t pin, int level, uint64_t t_ns);
+
+    SimMotion motion;
+    uint8_t squal;
+    uint16_t shutter;
+    uint8_t pixels[SIM_ADNS5020_FRAME_LENGTH];
+
+    // serial port timing checked by the model (ns)
+    uint32_t t_srad_ns;     // address to data (read)
+    uint32_t t_srx_ns;      // read to next command
+    uint32_t t_sww_ns;      // write to next write
+    uint32_t t_swr_ns;      // write to next read
+    uint32_t t_ncs_sclk_ns; // NCS low to first SCLK
+    uint32_t t_hold_ns;     // SDIO hold after rising SCLK
+    uint32_t t_frame_ns;    // pixel grab: time until the first pixel is valid
+    uint32_t t_wakeup_ns;   // reset to valid motion
+
+    uint8_t control;
+    bool powered() const { return _powered; }
+    int cpi() const { return (control & 0x01) ? 1000 : 500; }
+
+    // statistics
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t violations;
+    uint32_t control_writes;
+    uint64_t clocks;
+
+  private:
+    enum State { ADDR, WDATA, RDATA };
+
+    SimBus &_bus;
+    uint8_t _sclk;
+    uint8_t _sdio;
+    uint8_t _ncs;
+    uint8_t _nreset;
+    bool _selected;
+    int _sclk_level;
+    State _state;
+    int _bits;
+    uint8_t _shift;
+    uint8_t _addr;
+    uint8_t _out;
+    bool _burst;
+    int _burst_index;
+    uint64_t _t_rise;
+    uint64_t _t_ready_read;
+    uint64_t _t_ready_write;
+    uint64_t _t_awake;
+
+    bool _powered;
+    bool _latched;
+    int8_t _latch_x;
+    int8_t _latch_y;
+    int _pix_index;
+    uint64_t _t_pix_ready;
+
+    void chipReset(uint64_t t_ns);
+    void endTransfer();
+    uint8_t readRegister(uint8_t addr, uint64_t t_ns);
+    void writeRegister(uint8_t addr, uint8_t val, uint64_t t_ns);
+    void check(uint64_t t_ns, uint64_t earliest);
+};
+
+#endif  // __SIMADNS5020_H__
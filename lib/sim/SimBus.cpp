@@ -0,0 +1,113 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Simulated GPIO bus with virtual clock (native build)
+// ----------------------------------------------------------------------------
+
+#include "SimBus.h"
+#include "hal.h"
+
+SimBus::SimBus()
+{
+  gpio_cost_ns = 0;
+  fast_cost_ns = 0;
+  cpu_mhz = 240;
+  _now_ns = 0;
+  _num_devices = 0;
+  for (int i = 0; i < SIM_NUM_PINS; ++i) {
+    _out[i] = false;
+    _host_level[i] = LOW;
+    _dev_level[i] = -1;
+    _dev_until[i] = 0;
+  }
+  resetStats();
+}
+
+SimBus &sim_bus()
+{
+  static SimBus bus;
+  return bus;
+}
+
+void SimBus::resetStats()
+{
+  writes = 0;
+  reads = 0;
+  contentions = 0;
+}
+
+void SimBus::attach(SimDevice *dev)
+{
+  if (_num_devices < SIM_MAX_DEVICES)
+    _devices[_num_devices++] = dev;
+}
+
+void SimBus::detach(SimDevice *dev)
+{
+  for (int i = 0; i < _num_devices; ++i) {
+    if (_devices[i] == dev) {
+      _devices[i] = _devices[--_num_devices];
+      return;
+    }
+  }
+}
+
+void SimBus::pinMode(uint8_t pin, uint8_t mode, bool fast)
+{
+  if (pin >= SIM_NUM_PINS) return;
+  _now_ns += fast ? fast_cost_ns : gpio_cost_ns;
+  _out[pin] = (mode == OUTPUT);
+  if (_out[pin] && deviceDriving(pin))
+    ++contentions;
+}
+
+void SimBus::write(uint8_t pin, int level, bool fast)
+{
+  if (pin >= SIM_NUM_PINS) return;
+  _now_ns += fast ? fast_cost_ns : gpio_cost_ns;
+  ++writes;
+
+  level = level ? HIGH : LOW;
+  if (_host_level[pin] == level) return;
+  _host_level[pin] = level;
+  if (!_out[pin]) return;
+
+  for (int i = 0; i < _num_devices; ++i)
+    _devices[i]->pinChanged(pin, level, _now_ns);
+}
+
+int SimBus::read(uint8_t pin, bool fast)
+{
+  if (pin >= SIM_NUM_PINS) return LOW;
+  _now_ns += fast ? fast_cost_ns : gpio_cost_ns;
+  ++reads;
+
+  if (_out[pin]) return _host_level[pin];
+  if (deviceDriving(pin)) return _dev_level[pin];
+  return LOW;   // floating
+}
+
+void SimBus::drive(uint8_t pin, int level)
+{
+  if (pin >= SIM_NUM_PINS) return;
+  if (_out[pin]) ++contentions;
+  _dev_level[pin] = level ? HIGH : LOW;
+  _dev_until[pin] = UINT64_MAX;
+}
+
+void SimBus::release(uint8_t pin)
+{
+  if (pin >= SIM_NUM_PINS) return;
+  _dev_level[pin] = -1;
+}
+
+void SimBus::releaseAt(uint8_t pin, uint64_t t_ns)
+{
+  if (pin >= SIM_NUM_PINS) return;
+  _dev_until[pin] = t_ns;
+}
+
+int SimBus::level(uint8_t pin) const
+{
+  if (pin >= SIM_NUM_PINS) return LOW;
+  return _out[pin] ? _host_level[pin] : LOW;
+}
@@ -0,0 +1,77 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Simulated GPIO bus with virtual clock (native build)
+// ----------------------------------------------------------------------------
+
+#ifndef __SIMBUS_H__
+#define __SIMBUS_H__
+
+#include <stdint.h>
+#include "HostArduino.h"
+
+#define SIM_NUM_PINS    40
+#define SIM_MAX_DEVICES 8
+
+// A device model attached to the bus. It is notified about every level
+// change the host (i.e. the driver under test) makes on a pin, and can
+// drive pins itself while the host has them configured as INPUT.
+class SimDevice {
+  public:
+    virtual ~SimDevice() {}
+    virtual void pinChanged(uint8_t pin, int level, uint64_t t_ns) = 0;
+};
+
+class SimBus {
+  public:
+    SimBus();
+
+    void attach(SimDevice *dev);
+    void detach(SimDevice *dev);
+
+    // host side (called through hal.h), fast = register-level access
+    void pinMode(uint8_t pin, uint8_t mode, bool fast = false);
+    void write(uint8_t pin, int level, bool fast = false);
+    int read(uint8_t pin, bool fast = false);
+
+    // device side
+    void drive(uint8_t pin, int level);
+    void release(uint8_t pin);
+    void releaseAt(uint8_t pin, uint64_t t_ns);   // stop driving after hold time
+    int level(uint8_t pin) const;   // host-driven level as seen by a device
+    bool hostOutput(uint8_t pin) const { return _out[pin]; }
+
+    // virtual clock
+    uint64_t now() const { return _now_ns; }
+    void advance(uint64_t ns) { _now_ns += ns; }
+
+    // simulated cost of one pinMode/digitalWrite/digitalRead call
+    uint32_t gpio_cost_ns;
+    // same for a HalPin<> register access
+    uint32_t fast_cost_ns;
+    // CPU clock behind hal_cycles()
+    uint32_t cpu_mhz;
+
+    // statistics
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t contentions;   // host and device driving the same pin
+    void resetStats();
+
+  private:
+    uint64_t _now_ns;
+    bool _out[SIM_NUM_PINS];
+    uint8_t _host_level[SIM_NUM_PINS];
+    int8_t _dev_level[SIM_NUM_PINS];    // -1 = released (high-Z)
+    uint64_t _dev_until[SIM_NUM_PINS];
+
+    bool deviceDriving(uint8_t pin) const {
+      return _dev_level[pin] >= 0 && _now_ns < _dev_until[pin];
+    }
+    SimDevice *_devices[SIM_MAX_DEVICES];
+    int _num_devices;
+};
+
+// the bus instance behind hal.h
+SimBus &sim_bus();
+
+#endif  // __SIMBUS_H__
@@ -0,0 +1,136 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Software model of the MCS-12085 serial port (native build)
+// ----------------------------------------------------------------------------
+
+#include "SimMCS12085.h"
+
+#define MCS_REG_CONFIG  0x00
+#define MCS_REG_STATUS  0x01
+#define MCS_REG_DX      0x02
+#define MCS_REG_DY      0x03
+
+SimMCS12085::SimMCS12085(SimBus &bus, uint8_t sck, uint8_t sdio, float counts_per_mm)
+  : motion(counts_per_mm), _bus(bus)
+{
+  _sck = sck;
+  _sdio = sdio;
+
+  // ADNS-2051 compatible port timing
+  t_srad_ns = 100000;
+  t_srx_ns = 250;
+  t_sww_ns = 100000;
+  t_hold_ns = 200;
+  t_clk_ns = 100;
+
+  config = 0;
+  reads = writes = violations = 0;
+  clocks = 0;
+
+  _state = CMD;
+  _low_seen = false;
+  _bits = 0;
+  _shift = 0;
+  _addr = 0;
+  _out = 0;
+  _t_fall = _t_rise = _t_ready = 0;
+
+  _bus.attach(this);
+}
+
+SimMCS12085::~SimMCS12085()
+{
+  _bus.detach(this);
+}
+
+void SimMCS12085::check(uint64_t t_ns, uint64_t earliest)
+{
+  if (t_ns < earliest) ++violations;
+}
+
+uint8_t SimMCS12085::readRegister(uint8_t addr, uint64_t t_ns)
+{
+  motion.update(t_ns);
+  switch (addr) {
+    case MCS_REG_CONFIG:
+      return config;
+    case MCS_REG_STATUS:
+      return (motion.motion() ? 0x80 : 0)
+           | (motion.overflowY() ? 0x10 : 0)
+           | (motion.overflowX() ? 0x08 : 0);
+    case MCS_REG_DX:
+      return (uint8_t)motion.takeX();
+    case MCS_REG_DY:
+      return (uint8_t)motion.takeY();
+  }
+  return 0;
+}
+
+void SimMCS12085::writeRegister(uint8_t addr, uint8_t val)
+{
+  if (addr == MCS_REG_CONFIG)
+    config = val;
+}
+
+void SimMCS12085::pinChanged(uint8_t pin, int level, uint64_t t_ns)
+{
+  if (pin != _sck) return;
+
+  if (level == LOW) {
+    // a clock pulse only counts once we have seen its falling edge,
+    // so pulling SCK high during init is not taken for a bit
+    _low_seen = true;
+    check(t_ns, _t_rise + t_clk_ns);
+    _t_fall = t_ns;
+
+    if (_state == RDATA) {
+      if (_bits == 0) check(t_ns, _t_ready);
+      _bus.drive(_sdio, (_out & 0x80) ? HIGH : LOW);
+      _out <<= 1;
+    } else if (_bits == 0) {
+      check(t_ns, _t_ready);
+    }
+    return;
+  }
+
+  if (!_low_seen) return;
+  _low_seen = false;
+  check(t_ns, _t_fall + t_clk_ns);
+  _t_rise = t_ns;
+  ++clocks;
+
+  switch (_state) {
+    case CMD:
+      _shift = (_shift << 1) | (_bus.level(_sdio) ? 1 : 0);
+      if (++_bits < 8) break;
+      _bits = 0;
+      _addr = _shift & 0x7f;
+      if (_shift & 0x80) {
+        _state = WDATA;
+      } else {
+        _out = readRegister(_addr, t_ns);
+        _state = RDATA;
+        _t_ready = t_ns + t_srad_ns;
+      }
+      break;
+
+    case WDATA:
+      _shift = (_shift << 1) | (_bus.level(_sdio) ? 1 : 0);
+      if (++_bits < 8) break;
+      _bits = 0;
+      writeRegister(_addr, _shift);
+      ++writes;
+      _state = CMD;
+      _t_ready = t_ns + t_sww_ns;
+      break;
+
+    case RDATA:
+      if (++_bits < 8) break;
+      _bits = 0;
+      _bus.releaseAt(_sdio, t_ns + t_hold_ns);
+      ++reads;
+      _state = CMD;
+      _t_ready = t_ns + t_srx_ns;
+      break;
+  }
+}
@@ -0,0 +1,61 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Software model of the MCS-12085 serial port (native build)
+// ----------------------------------------------------------------------------
+
+#ifndef __SIMMCS12085_H__
+#define __SIMMCS12085_H__
+
+#include "SimBus.h"
+#include "SimMotion.h"
+
+// Two-wire protocol as used by the MCS12085 driver: SCK idles high, the
+// chip samples SDIO on the rising edge, outputs read data on the falling
+// edge and holds it through the following rising edge. A command byte with
+// MSB=0 is a register read, MSB=1 a write followed by one data byte.
+class SimMCS12085 : public SimDevice {
+  public:
+    SimMCS12085(SimBus &bus, uint8_t sck, uint8_t sdio, float counts_per_mm = 20);
+    ~SimMCS12085();
+
+    void pinChanged(uint8_t pin, int level, uint64_t t_ns);
+
+    SimMotion motion;
+
+    // serial port timing checked by the model (ns)
+    uint32_t t_srad_ns;     // command to first read clock
+    uint32_t t_srx_ns;      // end of read to next command
+    uint32_t t_sww_ns;      // end of write to next command
+    uint32_t t_hold_ns;     // SDIO hold after the last read clock
+    uint32_t t_clk_ns;      // minimum SCK low/high time
+
+    uint8_t config;
+
+    // statistics
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t violations;    // timing violations seen on the port
+    uint64_t clocks;
+
+  private:
+    enum State { CMD, WDATA, RDATA };
+
+    SimBus &_bus;
+    uint8_t _sck;
+    uint8_t _sdio;
+    State _state;
+    bool _low_seen;
+    int _bits;
+    uint8_t _shift;
+    uint8_t _addr;
+    uint8_t _out;
+    uint64_t _t_fall;
+    uint64_t _t_rise;
+    uint64_t _t_ready;      // earliest time for the next phase
+
+    uint8_t readRegister(uint8_t addr, uint64_t t_ns);
+    void writeRegister(uint8_t addr, uint8_t val);
+    void check(uint64_t t_ns, uint64_t earliest);
+};
+
+#endif  // __SIMMCS12085_H__
@@ -0,0 +1,101 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Surface motion model shared by the simulated optical sensors
+// ----------------------------------------------------------------------------
+
+#include "SimMotion.h"
+#include <math.h>
+
+SimMotion::SimMotion(float cpmm)
+{
+  counts_per_mm = cpmm;
+  true_mm_x = true_mm_y = 0;
+  true_x = true_y = 0;
+  lost_x = lost_y = 0;
+  saturations = 0;
+  _vx = _vy = 0;
+  _frac_x = _frac_y = 0;
+  _t_ns = 0;
+  _frozen = false;
+  _reg_x = _reg_y = 0;
+  _ovf_x = _ovf_y = false;
+}
+
+void SimMotion::setVelocity(float vx_mm_s, float vy_mm_s, uint64_t t_ns)
+{
+  update(t_ns);
+  _vx = vx_mm_s;
+  _vy = vy_mm_s;
+}
+
+void SimMotion::setResolution(float cpmm, uint64_t t_ns)
+{
+  update(t_ns);
+  counts_per_mm = cpmm;
+}
+
+void SimMotion::freeze(bool frozen, uint64_t t_ns)
+{
+  update(t_ns);
+  _frozen = frozen;
+}
+
+void SimMotion::accumulate(int &reg, bool &ovf, long &lost, int n)
+{
+  reg += n;
+  if (reg > 127) {
+    lost += reg - 127;
+    reg = 127;
+    ovf = true;
+    ++saturations;
+  } else if (reg < -128) {
+    lost += reg + 128;
+    reg = -128;
+    ovf = true;
+    ++saturations;
+  }
+}
+
+void SimMotion::move(int dx, int dy, bool counted)
+{
+  if (counted) {
+    true_x += dx;
+    true_y += dy;
+  }
+  accumulate(_reg_x, _ovf_x, lost_x, dx);
+  accumulate(_reg_y, _ovf_y, lost_y, dy);
+}
+
+void SimMotion::update(uint64_t t_ns)
+{
+  if (t_ns <= _t_ns) return;
+  double dt = (t_ns - _t_ns) * 1e-9;
+  _t_ns = t_ns;
+  if (_frozen) return;
+
+  true_mm_x += _vx * dt;
+  true_mm_y += _vy * dt;
+  _frac_x += _vx * counts_per_mm * dt;
+  _frac_y += _vy * counts_per_mm * dt;
+  int nx = (int)trunc(_frac_x);
+  int ny = (int)trunc(_frac_y);
+  _frac_x -= nx;
+  _frac_y -= ny;
+  if (nx || ny) move(nx, ny);
+}
+
+int8_t SimMotion::takeX()
+{
+  int8_t r = (int8_t)_reg_x;
+  _reg_x = 0;
+  _ovf_x = false;
+  return r;
+}
+
+int8_t SimMotion::takeY()
+{
+  int8_t r = (int8_t)_reg_y;
+  _reg_y = 0;
+  _ovf_y = false;
+  return r;
+}
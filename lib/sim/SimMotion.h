@@ -0,0 +1,51 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Surface motion model shared by the simulated optical sensors
+// ----------------------------------------------------------------------------
+
+#ifndef __SIMMOTION_H__
+#define __SIMMOTION_H__
+
+#include <stdint.h>
+
+// Integrates a (piecewise constant) surface velocity into sensor counts and
+// feeds them into 8-bit delta registers that saturate like the real chips.
+// true_x/true_y count everything the surface moved, lost_x/lost_y what was
+// clipped, so a driver can be checked against ground truth.
+class SimMotion {
+  public:
+    SimMotion(float counts_per_mm);
+
+    void setVelocity(float vx_mm_s, float vy_mm_s, uint64_t t_ns);
+    void setResolution(float counts_per_mm, uint64_t t_ns);
+    // instant displacement in counts; counted = false puts back counts
+    // that were taken from the registers before
+    void move(int dx, int dy, bool counted = true);
+    void update(uint64_t t_ns);     // integrate up to t_ns
+    void freeze(bool frozen, uint64_t t_ns);   // e.g. powered down
+
+    // register access; reading clears
+    int8_t takeX();
+    int8_t takeY();
+    bool motion() const { return _reg_x != 0 || _reg_y != 0; }
+    bool overflowX() const { return _ovf_x; }
+    bool overflowY() const { return _ovf_y; }
+
+    float counts_per_mm;
+    double true_mm_x, true_mm_y;    // surface travel, independent of resolution
+    long true_x, true_y;
+    long lost_x, lost_y;
+    uint32_t saturations;
+
+  private:
+    float _vx, _vy;
+    double _frac_x, _frac_y;
+    uint64_t _t_ns;
+    bool _frozen;
+    int _reg_x, _reg_y;
+    bool _ovf_x, _ovf_y;
+
+    void accumulate(int &reg, bool &ovf, long &lost, int n);
+};
+
+#endif  // __SIMMOTION_H__
@@ -0,0 +1,97 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Software model of a LoRa transmitter and the air (native build)
+// ----------------------------------------------------------------------------
+
+#include "SimRadio.h"
+#include <math.h>
+#include <string.h>
+
+SimRadio::SimRadio(SimBus &bus, uint8_t sf, uint32_t bw_hz, uint8_t cr, uint8_t preamble)
+  : _bus(bus)
+{
+  _sf = sf;
+  _bw_hz = bw_hz;
+  _cr = cr;
+  _preamble = preamble;
+  loss_permille = 0;
+  packets = busy = lost = 0;
+  on_air_ns = 0;
+  _tx_end = 0;
+  _rand = 12345;
+  _logged = 0;
+  _head = _count = 0;
+}
+
+// SX1276 datasheet, explicit header, CRC on
+uint64_t SimRadio::airtime_ns(uint8_t len) const
+{
+  double tsym = pow(2, _sf) / _bw_hz;
+  int de = tsym > 0.016 ? 1 : 0;
+  double n = ceil((8.0 * len - 4 * _sf + 28 + 16) / (4.0 * (_sf - 2 * de))) * _cr;
+  if (n < 0) n = 0;
+  double t = (_preamble + 4.25) * tsym + (8 + n) * tsym;
+  return (uint64_t)(t * 1e9);
+}
+
+bool SimRadio::send(const uint8_t *data, uint8_t len)
+{
+  uint64_t now = _bus.now();
+  if (now < _tx_end) {
+    ++busy;
+    return false;
+  }
+  uint64_t air = airtime_ns(len);
+  _tx_end = now + air;
+  on_air_ns += air;
+  ++packets;
+  if (_logged < SIM_RADIO_LOG) {
+    _log[_logged].start = now;
+    _log[_logged].end = _tx_end;
+    ++_logged;
+  }
+
+  _rand = _rand * 1103515245 + 12345;
+  if ((_rand >> 16) % 1000 < loss_permille) {
+    ++lost;
+    return true;
+  }
+  if (_count == SIM_RADIO_QUEUE) return true;   // nobody listening
+  Frame &f = _queue[(_head + _count) % SIM_RADIO_QUEUE];
+  f.len = len;
+  memcpy(f.data, data, len);
+  ++_count;
+  return true;
+}
+
+bool SimRadio::receive(uint8_t *data, uint8_t &len)
+{
+  if (_count == 0) return false;
+  Frame &f = _queue[_head];
+  len = f.len;
+  memcpy(data, f.data, len);
+  _head = (_head + 1) % SIM_RADIO_QUEUE;
+  --_count;
+  return true;
+}
+
+// windows ending where a transmission ends, the first one in the window
+// counted with its part inside
+double SimRadio::maxDuty(uint64_t window_ns) const
+{
+  double best = 0;
+  uint64_t sum = 0;
+  uint32_t first = 0;
+  for (uint32_t j = 0; j < _logged; ++j) {
+    sum += _log[j].end - _log[j].start;
+    uint64_t begin = _log[j].end > window_ns ? _log[j].end - window_ns : 0;
+    while (_log[first].end <= begin) {
+      sum -= _log[first].end - _log[first].start;
+      ++first;
+    }
+    uint64_t cut = _log[first].start < begin ? begin - _log[first].start : 0;
+    double duty = (double)(sum - cut) / window_ns;
+    if (duty > best) best = duty;
+  }
+  return best;
+}
@@ -0,0 +1,63 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Software model of a LoRa transmitter and the air (native build)
+// ----------------------------------------------------------------------------
+
+#ifndef __SIMRADIO_H__
+#define __SIMRADIO_H__
+
+#include "SimBus.h"
+
+#define SIM_RADIO_LOG     8192    // transmissions kept for the duty-cycle check
+#define SIM_RADIO_QUEUE   16      // delivered frames not yet received
+#define SIM_RADIO_PAYLOAD 255
+
+// A packet occupies the radio for its time on air, computed here from the
+// datasheet formula on its own (floating point), so the firmware's airtime
+// accounting can be checked against it. Every loss_permille-th packet on
+// average is lost on the way; the rest can be taken with receive().
+class SimRadio {
+  public:
+    SimRadio(SimBus &bus, uint8_t sf, uint32_t bw_hz, uint8_t cr, uint8_t preamble = 8);
+
+    bool send(const uint8_t *data, uint8_t len);    // false while on the air
+    bool receive(uint8_t *data, uint8_t &len);
+    uint64_t airtime_ns(uint8_t len) const;
+
+    // highest share of any window_ns the radio was on the air
+    double maxDuty(uint64_t window_ns) const;
+
+    uint16_t loss_permille;
+
+    // statistics
+    uint32_t packets;
+    uint32_t busy;          // sends refused while on the air
+    uint32_t lost;
+    uint64_t on_air_ns;
+
+  private:
+    SimBus &_bus;
+    uint8_t _sf;
+    uint32_t _bw_hz;
+    uint8_t _cr;
+    uint8_t _preamble;
+    uint64_t _tx_end;
+    uint32_t _rand;
+
+    struct Tx {
+      uint64_t start;
+      uint64_t end;
+    };
+    Tx _log[SIM_RADIO_LOG];
+    uint32_t _logged;
+
+    struct Frame {
+      uint8_t len;
+      uint8_t data[SIM_RADIO_PAYLOAD];
+    };
+    Frame _queue[SIM_RADIO_QUEUE];
+    uint8_t _head;
+    uint8_t _count;
+};
+
+#endif  // __SIMRADIO_H__
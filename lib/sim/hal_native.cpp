@@ -0,0 +1,75 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// HAL implementation for the native (host) build
+// ----------------------------------------------------------------------------
+
+#include "hal.h"
+#include "SimBus.h"
+
+void hal_pin_mode(uint8_t pin, uint8_t mode)
+{
+  sim_bus().pinMode(pin, mode);
+}
+
+void hal_write(uint8_t pin, uint8_t level)
+{
+  sim_bus().write(pin, level);
+}
+
+int hal_read(uint8_t pin)
+{
+  return sim_bus().read(pin);
+}
+
+// delays only advance the virtual clock, so bus timing can be
+// measured exactly and simulations run much faster than real time
+void hal_delay_us(uint32_t us)
+{
+  sim_bus().advance((uint64_t)us * 1000);
+}
+
+void hal_delay_ms(uint32_t ms)
+{
+  sim_bus().advance((uint64_t)ms * 1000000);
+}
+
+// the simulated CPU just skips the time
+void hal_light_sleep_us(uint32_t us)
+{
+  sim_bus().advance((uint64_t)us * 1000);
+}
+
+unsigned long hal_micros()
+{
+  return (unsigned long)(sim_bus().now() / 1000);
+}
+
+unsigned long hal_millis()
+{
+  return (unsigned long)(sim_bus().now() / 1000000);
+}
+
+uint32_t hal_cycles()
+{
+  return (uint32_t)(sim_bus().now() * sim_bus().cpu_mhz / 1000);
+}
+
+void hal_delay_ns(uint32_t ns)
+{
+  sim_bus().advance(ns);
+}
+
+void hal_fast_write(uint8_t pin, uint8_t level)
+{
+  sim_bus().write(pin, level, true);
+}
+
+int hal_fast_read(uint8_t pin)
+{
+  return sim_bus().read(pin, true);
+}
+
+void hal_fast_mode(uint8_t pin, uint8_t mode)
+{
+  sim_bus().pinMode(pin, mode, true);
+}
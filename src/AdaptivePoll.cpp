@@ -0,0 +1,42 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Adaptive sensor polling interval
+// ----------------------------------------------------------------------------
+
+#include "AdaptivePoll.h"
+
+AdaptivePoll::AdaptivePoll(uint32_t min_interval_us, uint32_t max_interval_us, int target)
+{
+  min_us = min_interval_us;
+  max_us = max_interval_us;
+  target_counts = target;
+  samples = saturated = saturated_at_min = idle = 0;
+  _interval_us = min_us;
+}
+
+uint32_t AdaptivePoll::update(int dx, int dy)
+{
+  int ax = dx < 0 ? -dx : dx;
+  int ay = dy < 0 ? -dy : dy;
+  int peak = ax > ay ? ax : ay;
+  ++samples;
+
+  uint32_t next;
+  if (peak >= 127) {
+    ++saturated;
+    if (_interval_us <= min_us) ++saturated_at_min;
+    next = min_us;
+  } else if (peak == 0) {
+    ++idle;
+    next = _interval_us * 2;
+  } else {
+    // scale so the next delta lands on the target at the current speed
+    next = (uint32_t)((uint64_t)_interval_us * target_counts / peak);
+    if (next > _interval_us * 2) next = _interval_us * 2;
+  }
+
+  if (next < min_us) next = min_us;
+  if (next > max_us) next = max_us;
+  _interval_us = next;
+  return next;
+}
@@ -0,0 +1,38 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Adaptive sensor polling interval
+// ----------------------------------------------------------------------------
+
+#ifndef __ADAPTIVEPOLL_H__
+#define __ADAPTIVEPOLL_H__
+
+#include <stdint.h>
+
+// Chooses the next polling interval from the size of the last delta so the
+// 8-bit DX/DY registers stay around target_counts, well below the -128..127
+// limit: the interval shrinks immediately when the deltas grow (down to
+// min_us, at once on a saturated register) and grows at most 2x per sample
+// when the sensor slows down or stands still (up to max_us).
+class AdaptivePoll {
+  public:
+    AdaptivePoll(uint32_t min_us, uint32_t max_us, int target_counts = 32);
+
+    // feed one sample, returns the interval until the next one
+    uint32_t update(int dx, int dy);
+    uint32_t interval() const { return _interval_us; }
+
+    uint32_t min_us;
+    uint32_t max_us;
+    int target_counts;
+
+    // statistics
+    uint32_t samples;
+    uint32_t saturated;         // samples with a clipped DX or DY register
+    uint32_t saturated_at_min;  // ... even at the shortest interval
+    uint32_t idle;              // samples without motion
+
+  private:
+    uint32_t _interval_us;
+};
+
+#endif  // __ADAPTIVEPOLL_H__
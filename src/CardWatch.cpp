@@ -0,0 +1,89 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Interrupt-driven RFID card detection with the MFRC522 IRQ line
+// ----------------------------------------------------------------------------
+
+#ifdef ARDUINO
+
+#include "CardWatch.h"
+
+#define COMIEN_IRQ_INV   0x80   // IRQ pin active low
+#define COMIEN_RX        0x20   // receiver detected end of valid data stream
+#define COMIRQ_CLEAR     0x7f   // Set1 = 0: clear all ComIrqReg bits
+#define COMIRQ_RX        0x20
+#define DIVIEN_PUSHPULL  0x80   // IRQ pin push-pull, the ESP32 input has no pull-up
+#define ERROR_RX         0x13   // BufferOvfl, ParityErr, ProtocolErr
+#define BITFRAMING_REQA  0x87   // StartSend, 7 bit short frame
+
+CardWatch::CardWatch(MFRC522 &reader, int8_t irq_pin, uint32_t period_ms)
+  : _reader(reader)
+{
+  _irq_pin = irq_pin;
+  _period_ms = period_ms;
+  _armed_ms = 0;
+  _irq = false;
+  _irq_us = 0;
+  requests = 0;
+  irqs = 0;
+  cards = 0;
+}
+
+void IRAM_ATTR CardWatch::isr(void *self)
+{
+  CardWatch *watch = static_cast<CardWatch *>(self);
+  watch->_irq_us = micros();
+  watch->_irq = true;
+}
+
+void CardWatch::begin()
+{
+  pinMode(_irq_pin, INPUT);
+  configure();
+  attachInterruptArg(digitalPinToInterrupt(_irq_pin), isr, this, FALLING);
+}
+
+void CardWatch::configure()
+{
+  _reader.PCD_WriteRegister(MFRC522::ComIEnReg, COMIEN_IRQ_INV | COMIEN_RX);
+  _reader.PCD_WriteRegister(MFRC522::DivIEnReg, DIVIEN_PUSHPULL);
+  _reader.PCD_WriteRegister(MFRC522::ComIrqReg, COMIRQ_CLEAR);
+  _irq = false;
+}
+
+void CardWatch::arm(uint32_t now_ms)
+{
+  // PCD_Init() left the timer in auto mode, it ends the receive window.
+
+  // stop whatever command is running and empty the FIFO, so REQA is its
+  // only byte
+  _reader.PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_Idle);
+  _reader.PCD_WriteRegister(MFRC522::FIFOLevelReg, 0x80);
+
+  // drop IRQs raised by the library's own exchanges since the last REQA
+  _reader.PCD_WriteRegister(MFRC522::ComIrqReg, COMIRQ_CLEAR);
+  _irq = false;
+  _reader.PCD_WriteRegister(MFRC522::FIFODataReg, MFRC522::PICC_CMD_REQA);
+  _reader.PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_Transceive);
+  _reader.PCD_WriteRegister(MFRC522::BitFramingReg, BITFRAMING_REQA);
+  _armed_ms = now_ms;
+  ++requests;
+}
+
+bool CardWatch::answered()
+{
+  _irq = false;
+  ++irqs;
+
+  byte irq = _reader.PCD_ReadRegister(MFRC522::ComIrqReg);
+  byte err = _reader.PCD_ReadRegister(MFRC522::ErrorReg);
+  _reader.PCD_WriteRegister(MFRC522::ComIrqReg, COMIRQ_CLEAR);
+  _reader.PCD_WriteRegister(MFRC522::BitFramingReg, 0x00);   // stop transceive
+
+  // an ATQA is two bytes
+  if (!(irq & COMIRQ_RX) || (err & ERROR_RX)) return false;
+  if (_reader.PCD_ReadRegister(MFRC522::FIFOLevelReg) != 2) return false;
+  ++cards;
+  return true;
+}
+
+#endif  // ARDUINO
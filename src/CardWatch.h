@@ -0,0 +1,56 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Interrupt-driven RFID card detection with the MFRC522 IRQ line
+// ----------------------------------------------------------------------------
+
+#ifndef __CARDWATCH_H__
+#define __CARDWATCH_H__
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <MFRC522.h>
+
+// Instead of a full PICC_IsNewCardPresent() exchange on every loop, a
+// REQA is queued in the reader every period_ms (four register writes) and
+// the reader pulls its IRQ line when a card answers. The main loop only
+// touches the reader when an answer is pending or the next REQA is due;
+// the reader has to be on the SPI bus for both.
+class CardWatch {
+  public:
+    CardWatch(MFRC522 &reader, int8_t irq_pin, uint32_t period_ms);
+
+    void begin();               // configure the reader IRQ, attach the ISR
+    void configure();           // again after every PCD_Init()
+
+    bool pending() const { return _irq; }
+    uint32_t irq_us() const { return _irq_us; }   // when the last IRQ came in
+    bool due(uint32_t now_ms) const { return now_ms - _armed_ms >= _period_ms; }
+    void setPeriod(uint32_t period_ms) { _period_ms = period_ms; }
+
+    // send the next REQA, the answer (if any) raises the IRQ
+    void arm(uint32_t now_ms);
+
+    // check a pending IRQ: true if a card answered the REQA, which leaves
+    // it ready for PICC_ReadCardSerial(); re-arm afterwards
+    bool answered();
+
+    // statistics
+    uint32_t requests;
+    uint32_t irqs;
+    uint32_t cards;
+
+  private:
+    MFRC522 &_reader;
+    int8_t _irq_pin;
+    uint32_t _period_ms;
+    uint32_t _armed_ms;
+    volatile bool _irq;
+    volatile uint32_t _irq_us;
+
+    static void IRAM_ATTR isr(void *self);
+};
+
+#endif  // ARDUINO
+
+#endif  // __CARDWATCH_H__
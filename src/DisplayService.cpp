@@ -0,0 +1,115 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Status display rendered and flushed on its own task
+// ----------------------------------------------------------------------------
+
+#include "DisplayService.h"
+
+#ifndef ARDUINO
+#include <chrono>
+
+// frame times on the host are wall clock, hal_micros() may be simulated
+static uint32_t frame_clock_us()
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#else
+#define frame_clock_us micros
+#endif
+
+DisplayService::DisplayService(RenderFn render, void *screen, uint32_t interval_ms)
+{
+  _render = render;
+  _screen = screen;
+  _interval_ms = interval_ms;
+  _running = false;
+  frames = 0;
+  last_frame_us = 0;
+  max_frame_us = 0;
+#ifdef ARDUINO
+  _task = NULL;
+#endif
+}
+
+bool DisplayService::renderOnce()
+{
+  if (!_mailbox.take(_current)) return false;
+
+  uint32_t t0 = frame_clock_us();
+  _render(_screen, _current);
+  uint32_t dt = frame_clock_us() - t0;
+
+  last_frame_us = dt;
+  if (dt > max_frame_us) max_frame_us = dt;
+  frames = frames + 1;
+  return true;
+}
+
+#ifdef ARDUINO
+
+bool DisplayService::start(int core, int priority)
+{
+  if (_running) return true;
+  _running = true;
+  if (xTaskCreatePinnedToCore(task, "display", 4096, this, priority, &_task, core) != pdPASS) {
+    _running = false;
+    return false;
+  }
+  return true;
+}
+
+void DisplayService::stop()
+{
+  // the task deletes itself at the end of its current frame
+  _running = false;
+}
+
+void DisplayService::task(void *self)
+{
+  static_cast<DisplayService *>(self)->run();
+  vTaskDelete(NULL);
+}
+
+void DisplayService::run()
+{
+  TickType_t wake = xTaskGetTickCount();
+  TickType_t interval = pdMS_TO_TICKS(_interval_ms);
+  if (interval == 0) interval = 1;
+
+  while (_running) {
+    renderOnce();
+    vTaskDelayUntil(&wake, interval);
+  }
+  _task = NULL;
+}
+
+#else
+
+bool DisplayService::start(int /* core */, int /* priority */)
+{
+  if (_running) return true;
+  _running = true;
+  _thread = std::thread(&DisplayService::run, this);
+  return true;
+}
+
+void DisplayService::stop()
+{
+  _running = false;
+  if (_thread.joinable()) _thread.join();
+}
+
+void DisplayService::run()
+{
+  using namespace std::chrono;
+  steady_clock::time_point wake = steady_clock::now();
+
+  while (_running) {
+    renderOnce();
+    wake += milliseconds(_interval_ms);
+    std::this_thread::sleep_until(wake);
+  }
+}
+
+#endif
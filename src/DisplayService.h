@@ -0,0 +1,68 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Status display rendered and flushed on its own task
+// ----------------------------------------------------------------------------
+
+#ifndef __DISPLAYSERVICE_H__
+#define __DISPLAYSERVICE_H__
+
+#include "hal.h"
+#include "Mailbox.h"
+
+#ifndef ARDUINO
+#include <thread>
+#endif
+
+// everything the status screen shows, copied by value into the mailbox
+struct StatusSnapshot {
+  char vehicle[12];
+  char ip[16];
+  char location[24];
+  char destination[24];
+  long distance_mm;
+};
+
+// Takes status snapshots from the main loop and draws them on a separate
+// task (pinned to a core on the ESP32, a std::thread on the host), at most
+// once per frame interval. post() never waits for the display: only the
+// newest snapshot is kept, older unrendered ones are dropped.
+class DisplayService {
+  public:
+    typedef void (*RenderFn)(void *screen, const StatusSnapshot &s);
+
+    DisplayService(RenderFn render, void *screen, uint32_t interval_ms);
+
+    bool start(int core = 0, int priority = 1);
+    void stop();
+    bool running() const { return _running; }
+
+    // producer side (main loop)
+    void post(const StatusSnapshot &s) { _mailbox.post(s); }
+
+    // statistics, written by the display task only
+    volatile uint32_t frames;
+    volatile uint32_t last_frame_us;   // render + flush time
+    volatile uint32_t max_frame_us;
+    uint32_t dropped() const { return _mailbox.dropped(); }
+
+    // render the pending snapshot, if any, now
+    bool renderOnce();
+
+  private:
+    RenderFn _render;
+    void *_screen;
+    uint32_t _interval_ms;
+    volatile bool _running;
+    Mailbox<StatusSnapshot> _mailbox;
+    StatusSnapshot _current;
+
+#ifdef ARDUINO
+    TaskHandle_t _task;
+    static void task(void *self);
+#else
+    std::thread _thread;
+#endif
+    void run();
+};
+
+#endif  // __DISPLAYSERVICE_H__
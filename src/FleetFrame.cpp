@@ -0,0 +1,201 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Bit-packed position reports for the LoRa fleet link
+// ----------------------------------------------------------------------------
+
+#include "FleetFrame.h"
+#include <string.h>
+
+#define POS_BITS   18
+#define POS_MAX    ((1L << (POS_BITS - 1)) - 1)
+#define WIDTH_MAX  15
+
+struct BitWriter {
+  uint8_t *out;
+  uint16_t bits;
+
+  void put(uint32_t v, uint8_t n) {
+    while (n--) {
+      if ((bits & 7) == 0) out[bits >> 3] = 0;
+      if ((v >> n) & 1) out[bits >> 3] |= 0x80 >> (bits & 7);
+      ++bits;
+    }
+  }
+  uint8_t bytes() const { return (bits + 7) >> 3; }
+};
+
+struct BitReader {
+  const uint8_t *in;
+  uint16_t bits;
+  uint16_t size;          // in bits
+
+  bool get(uint8_t n, uint32_t &v) {
+    if (bits + n > size) return false;
+    v = 0;
+    while (n--) {
+      v = (v << 1) | ((in[bits >> 3] >> (7 - (bits & 7))) & 1);
+      ++bits;
+    }
+    return true;
+  }
+  bool getSigned(uint8_t n, int32_t &v) {
+    uint32_t u;
+    if (!get(n, u)) return false;
+    v = (int32_t)(u << (32 - n)) >> (32 - n);
+    return true;
+  }
+};
+
+static inline int32_t clamp(int32_t v, int32_t limit)
+{
+  return v > limit ? limit : v < -limit ? -limit : v;
+}
+
+// bits for a signed value
+static uint8_t width(int32_t v)
+{
+  uint8_t n = 1;
+  while (v >= (1L << (n - 1)) || v < -(1L << (n - 1))) ++n;
+  return n;
+}
+
+static void put_tail(BitWriter &w, const Pose &p)
+{
+  w.put(p.heading >> 24, 8);
+  w.put((uint8_t)clamp(p.v_fwd_mm_s / 20, 127), 8);
+}
+
+
+FleetEncoder::FleetEncoder(uint8_t vehicle)
+{
+  _vehicle = vehicle;
+  _seq = 0;
+  _since_key = FLEET_KEY_EVERY;
+  _key_x = _key_y = 0;
+  _kind = FLEET_KEY;
+  _x = _y = 0;
+  keys = deltas = tags = 0;
+}
+
+uint8_t FleetEncoder::encode(const Pose &p, uint8_t *out)
+{
+  _x = clamp(p.x_um / 10000, POS_MAX);
+  _y = clamp(p.y_um / 10000, POS_MAX);
+  int32_t dx = _x - _key_x, dy = _y - _key_y;
+  uint8_t n = width(dx) > width(dy) ? width(dx) : width(dy);
+
+  BitWriter w = { out, 0 };
+  w.put(_vehicle, 8);
+  w.put(_seq, 4);
+  if (_since_key >= FLEET_KEY_EVERY || n > WIDTH_MAX) {
+    _kind = FLEET_KEY;
+    w.put(FLEET_KEY, 2);
+    w.put(_x, POS_BITS);
+    w.put(_y, POS_BITS);
+  } else {
+    _kind = FLEET_DELTA;
+    w.put(FLEET_DELTA, 2);
+    w.put(_since_key, 3);
+    w.put(n, 4);
+    w.put(dx, n);
+    w.put(dy, n);
+  }
+  put_tail(w, p);
+  return w.bytes();
+}
+
+uint8_t FleetEncoder::encodeTag(const Pose &p, uint16_t tag, uint8_t *out)
+{
+  _kind = FLEET_TAG;
+  _x = clamp(p.x_um / 10000, POS_MAX);
+  _y = clamp(p.y_um / 10000, POS_MAX);
+
+  BitWriter w = { out, 0 };
+  w.put(_vehicle, 8);
+  w.put(_seq, 4);
+  w.put(FLEET_TAG, 2);
+  w.put(_x, POS_BITS);
+  w.put(_y, POS_BITS);
+  put_tail(w, p);
+  w.put(tag > FLEET_TAG_UNKNOWN ? FLEET_TAG_UNKNOWN : tag, 10);
+  return w.bytes();
+}
+
+void FleetEncoder::sent()
+{
+  _seq = (_seq + 1) & 15;
+  if (_kind != FLEET_KEY) {
+    if (_kind == FLEET_DELTA) ++deltas;
+    else ++tags;
+    if (_since_key < FLEET_KEY_EVERY) ++_since_key;
+    return;
+  }
+  ++keys;
+  _key_x = _x;
+  _key_y = _y;
+  _since_key = 1;
+}
+
+
+FleetDecoder::FleetDecoder()
+{
+  memset(_key_valid, 0, sizeof(_key_valid));
+  _last_seq = -1;
+  frames = missing = no_key = 0;
+}
+
+bool FleetDecoder::decode(const uint8_t *data, uint8_t len, FleetReport &out)
+{
+  BitReader r = { data, 0, (uint16_t)(len * 8) };
+  uint32_t v, kind;
+  if (!r.get(8, v)) return false;
+  out.vehicle = v;
+  if (!r.get(4, v) || !r.get(2, kind)) return false;
+  out.seq = v;
+  out.kind = kind;
+
+  // the slots of frames that never arrived hold nothing usable
+  if (_last_seq >= 0) {
+    for (int s = (_last_seq + 1) & 15; s != out.seq; s = (s + 1) & 15) {
+      _key_valid[s] = false;
+      ++missing;
+    }
+  }
+  _last_seq = out.seq;
+  _key_valid[out.seq] = false;
+
+  if (kind == FLEET_DELTA) {
+    uint32_t age, n;
+    int32_t dx, dy;
+    if (!r.get(3, age) || !r.get(4, n) || n == 0 ||
+        !r.getSigned(n, dx) || !r.getSigned(n, dy)) return false;
+    int key = (out.seq - age) & 15;
+    if (age == 0 || !_key_valid[key]) {
+      ++no_key;
+      return false;
+    }
+    out.x_cm = _key_x[key] + dx;
+    out.y_cm = _key_y[key] + dy;
+  } else if (kind == FLEET_KEY || kind == FLEET_TAG) {
+    if (!r.getSigned(POS_BITS, out.x_cm) || !r.getSigned(POS_BITS, out.y_cm)) return false;
+  } else {
+    return false;
+  }
+
+  int32_t speed;
+  if (!r.get(8, v) || !r.getSigned(8, speed)) return false;
+  out.heading = v;
+  out.speed_mm_s = speed * 20;
+  out.tag = 0;
+  if (kind == FLEET_TAG) {
+    if (!r.get(10, v)) return false;
+    out.tag = v;
+  }
+  if (kind != FLEET_DELTA) {
+    _key_valid[out.seq] = true;
+    _key_x[out.seq] = out.x_cm;
+    _key_y[out.seq] = out.y_cm;
+  }
+  ++frames;
+  return true;
+}
@@ -0,0 +1,88 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Bit-packed position reports for the LoRa fleet link
+// ----------------------------------------------------------------------------
+
+#ifndef __FLEETFRAME_H__
+#define __FLEETFRAME_H__
+
+#include <stdint.h>
+#include "Pose.h"
+
+// Frame layout, bit by bit from the MSB of the first byte:
+//   vehicle 8, seq 4, kind 2, then
+//   key:   x 18, y 18, heading 8, speed 8                 66 bits,  9 bytes
+//   tag:   x 18, y 18, heading 8, speed 8, tag 10         76 bits, 10 bytes
+//   delta: age 3, width 4, dx width, dy width,
+//          heading 8, speed 8                       37 + 2 width bits
+// Positions in cm (signed, +-1310 m), heading in 1/256 turns, forward
+// speed in 20 mm/s steps (signed). A delta is relative to the key frame
+// age frames before it. A lost delta loses only itself, a lost key the
+// deltas up to the next one: at a loss rate p about p of all deltas can't
+// be decoded. Keys go out every FLEET_KEY_EVERY frames, tag frames
+// counted but not used as keys (they come at random times), and whenever
+// the delta would need more than 15 bits.
+
+#define FLEET_FRAME_MAX     12
+#define FLEET_KEY_EVERY     4
+#define FLEET_TAG_UNKNOWN   1023    // a tag that is not in the table
+
+enum FleetKind { FLEET_KEY, FLEET_DELTA, FLEET_TAG };
+
+struct FleetReport {
+  uint8_t vehicle;
+  uint8_t seq;
+  uint8_t kind;
+  int32_t x_cm;
+  int32_t y_cm;
+  uint8_t heading;        // 1/256 turns
+  int16_t speed_mm_s;
+  uint16_t tag;           // FLEET_TAG frames
+};
+
+// encode() builds the next frame without committing to it; sent() makes
+// it the current one (sequence number, key) once the radio took it.
+class FleetEncoder {
+  public:
+    FleetEncoder(uint8_t vehicle);
+
+    uint8_t encode(const Pose &p, uint8_t *out);                 // key or delta
+    uint8_t encodeTag(const Pose &p, uint16_t tag, uint8_t *out);
+    void sent();
+
+    // statistics
+    uint32_t keys;
+    uint32_t deltas;
+    uint32_t tags;
+
+  private:
+    uint8_t _vehicle;
+    uint8_t _seq;
+    uint8_t _since_key;     // frames since the last key, FLEET_KEY_EVERY: none yet
+    int32_t _key_x, _key_y;
+
+    // the frame encode() built
+    uint8_t _kind;
+    int32_t _x, _y;
+};
+
+// Keeps the keys of the last 16 frames by sequence number; frames that
+// went missing clear their slot, so a delta never uses a stale key.
+class FleetDecoder {
+  public:
+    FleetDecoder();
+
+    bool decode(const uint8_t *data, uint8_t len, FleetReport &out);
+
+    // statistics
+    uint32_t frames;
+    uint32_t missing;       // sequence numbers skipped
+    uint32_t no_key;        // deltas whose key was lost
+
+  private:
+    bool _key_valid[16];
+    int32_t _key_x[16], _key_y[16];
+    int _last_seq;          // -1: none yet
+};
+
+#endif  // __FLEETFRAME_H__
@@ -0,0 +1,196 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Vehicle motion and pose from several optical flow sensors
+// ----------------------------------------------------------------------------
+
+#include <math.h>
+#include "FlowFusion.h"
+
+// first quarter of a sine wave, Q15
+static const int16_t sin_table[65] = {
+      0,   804,  1608,  2410,  3212,  4011,  4808,  5602,
+   6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+  12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+  18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+  23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+  27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+  30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+  32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+  32767,
+};
+
+int32_t fusion_sin(uint32_t angle)
+{
+  uint32_t quadrant = angle >> 30;
+  uint32_t phase = angle & 0x3fffffff;
+  if (quadrant & 1) phase = 0x40000000 - phase;
+
+  uint32_t i = phase >> 24;
+  int32_t v = sin_table[i];
+  if (i < 64) v += ((sin_table[i + 1] - v) * (int32_t)((phase >> 16) & 0xff)) >> 8;
+  return (quadrant & 2) ? -v : v;
+}
+
+// urad -> binary angle, Q12 factor (2^32 / 2pi / 1e6 * 4096)
+#define URAD_TO_BAM_Q12 2799884
+
+FlowFusion::FlowFusion(int32_t reject_um)
+{
+  this->reject_um = reject_um;
+  squal_pct = 60;
+  hold_ms = 500;
+  _count = 0;
+  batches = rejected = low_quality = saturated = no_rotation = 0;
+  _omega = 0;
+  _omega_us = _t_us = 0;
+}
+
+int FlowFusion::addSensor(const FlowMount &mount)
+{
+  if (_count == FUSION_MAX_SENSORS) return -1;
+  Sensor &s = _sensors[_count];
+  s.x_mm = mount.x_mm;
+  s.y_mm = mount.y_mm;
+  float c = mount.um_per_count * 65536.0f * cosf(mount.angle);
+  float n = mount.um_per_count * 65536.0f * sinf(mount.angle);
+  s.m[0] = lrintf(c);
+  s.m[1] = lrintf(-n);
+  s.m[2] = lrintf(n);
+  s.m[3] = lrintf(c);
+  s.weight = mount.weight ? mount.weight : 1;
+  s.min_squal = mount.min_squal;
+  s.dx = s.dy = 0;
+  s.squal_sum = 0;
+  s.samples = 0;
+  s.flags = 0;
+  return _count++;
+}
+
+void FlowFusion::add(int sensor, const MotionSample &s)
+{
+  Sensor &sn = _sensors[sensor];
+  sn.dx += s.dx;
+  sn.dy += s.dy;
+  sn.squal_sum += s.squal;
+  sn.samples++;
+  sn.flags |= s.flags;
+  if ((int32_t)(s.t_us - _t_us) > 0) _t_us = s.t_us;
+}
+
+// weighted least squares for v_i = t + w x p_i: with W = sum(w), P = sum(w p),
+// S = sum(w |p|^2), b = sum(w v), q = sum(w (p x v)) the rotation is
+// (W q - P x b) / (W S - |P|^2), then t = (b - w x P) / W. If the rotation
+// can't be observed the omega passed in is used.
+bool FlowFusion::fit(const int32_t *vx, const int32_t *vy, const uint32_t *w, uint8_t used,
+                     FlowMotion &m, int64_t &omega) const
+{
+  int64_t W = 0, px = 0, py = 0, S = 0, bx = 0, by = 0, q = 0;
+  int n = 0;
+  for (int i = 0; i < _count; ++i) {
+    if (!(used & (1 << i))) continue;
+    const Sensor &s = _sensors[i];
+    W += w[i];
+    px += (int64_t)w[i] * s.x_mm;
+    py += (int64_t)w[i] * s.y_mm;
+    S += (int64_t)w[i] * ((int64_t)s.x_mm * s.x_mm + (int64_t)s.y_mm * s.y_mm);
+    bx += (int64_t)w[i] * vx[i];
+    by += (int64_t)w[i] * vy[i];
+    q += (int64_t)w[i] * ((int64_t)s.x_mm * vy[i] - (int64_t)s.y_mm * vx[i]);
+    ++n;
+  }
+  if (!n) return false;
+
+  int64_t den = W * S - (px * px + py * py);
+  m.rotation = (n > 1 && den > 0);
+  if (m.rotation) omega = (W * q - (px * by - py * bx)) * 1000 / den;   // urad
+
+  // w x P in um: mm * urad / 1000
+  m.dx_um = (int32_t)((bx + omega * py / 1000) / W);
+  m.dy_um = (int32_t)((by - omega * px / 1000) / W);
+  m.dtheta = (int32_t)((omega * URAD_TO_BAM_Q12) >> 12);
+  m.sensors = n;
+  return true;
+}
+
+bool FlowFusion::solve(FlowMotion &m)
+{
+  int32_t vx[FUSION_MAX_SENSORS];
+  int32_t vy[FUSION_MAX_SENSORS];
+  uint32_t w[FUSION_MAX_SENSORS];
+  uint32_t squal[FUSION_MAX_SENSORS];
+  uint32_t best = 0;
+  uint8_t used = 0;
+
+  for (int i = 0; i < _count; ++i) {
+    Sensor &s = _sensors[i];
+    squal[i] = s.samples ? s.squal_sum / s.samples : 0;
+    if (squal[i] > best) best = squal[i];
+  }
+
+  uint8_t clipped = 0;
+  for (int i = 0; i < _count; ++i) {
+    Sensor &s = _sensors[i];
+    if (s.samples) {
+      // a sensor seeing much less of the floor than the best one tends to
+      // lose counts (gloss, dust, lifted)
+      if (squal[i] < s.min_squal || squal[i] * 100 < best * squal_pct) {
+        ++low_quality;
+      } else {
+        // sensor frame counts -> vehicle frame um
+        vx[i] = (int32_t)(((int64_t)s.m[0] * s.dx + (int64_t)s.m[1] * s.dy) >> 16);
+        vy[i] = (int32_t)(((int64_t)s.m[2] * s.dx + (int64_t)s.m[3] * s.dy) >> 16);
+        w[i] = squal[i] ? squal[i] : s.weight;
+        used |= 1 << i;
+        if (s.flags & (SAMPLE_SAT_X | SAMPLE_SAT_Y)) clipped |= 1 << i;
+      }
+    }
+    s.dx = s.dy = 0;
+    s.squal_sum = 0;
+    s.samples = 0;
+    s.flags = 0;
+  }
+
+  // a sensor that clipped during the batch is short of counts; left alone
+  // its clipped counts still beat losing the batch
+  if (clipped && (used & ~clipped)) {
+    used &= ~clipped;
+    for (int i = 0; i < _count; ++i) saturated += (clipped >> i) & 1;
+  }
+
+  // unobserved rotation: keep turning as before, for a while
+  uint32_t hold_us = (uint32_t)hold_ms * 1000;
+  uint32_t age = _t_us - _omega_us;
+  int64_t hold = age < hold_us ? _omega : 0;
+  int64_t omega = hold;
+  if (!fit(vx, vy, w, used, m, omega)) return false;
+
+  // drop the worst sensor while one disagrees with the fit
+  int64_t limit = (int64_t)reject_um * reject_um;
+  while (m.sensors > 1) {
+    int worst = -1;
+    int64_t worst_e = limit;
+    for (int i = 0; i < _count; ++i) {
+      if (!(used & (1 << i))) continue;
+      int64_t ex = vx[i] - (m.dx_um - omega * _sensors[i].y_mm / 1000);
+      int64_t ey = vy[i] - (m.dy_um + omega * _sensors[i].x_mm / 1000);
+      int64_t e = ex * ex + ey * ey;
+      if (e > worst_e) {
+        worst_e = e;
+        worst = i;
+      }
+    }
+    if (worst < 0) break;
+    used &= ~(1 << worst);
+    ++rejected;
+    omega = hold;
+    fit(vx, vy, w, used, m, omega);
+  }
+  if (m.rotation) {
+    _omega = omega;
+    _omega_us = _t_us;
+  } else {
+    ++no_rotation;
+  }
+  ++batches;
+  return true;
+}
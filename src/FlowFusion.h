@@ -0,0 +1,104 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Vehicle motion and pose from several optical flow sensors
+// ----------------------------------------------------------------------------
+
+#ifndef __FLOWFUSION_H__
+#define __FLOWFUSION_H__
+
+#include <stdint.h>
+#include "FlowSensor.h"
+
+#define FUSION_MAX_SENSORS 4
+
+// angles are binary: 2^32 is a full turn
+#define FUSION_BAM_PER_RAD 683565275.6
+#define FUSION_DEG(bam) ((int32_t)(bam) * (180.0 / 2147483648.0))
+
+// where a sensor sits on the vehicle: position from the rotation center
+// (x forward, y left), the angle of its x axis against the vehicle x axis,
+// and its resolution
+struct FlowMount {
+  int32_t x_mm;
+  int32_t y_mm;
+  float angle;            // rad
+  float um_per_count;
+  uint8_t weight;         // for sensors without a quality register
+  uint8_t min_squal;      // lower surface quality: sensor ignored
+};
+
+// motion of one batch in the vehicle frame
+struct FlowMotion {
+  int32_t dx_um;
+  int32_t dy_um;
+  int32_t dtheta;         // binary angle
+  uint8_t sensors;        // sensors used
+  bool rotation;          // dtheta was observed, not assumed 0
+};
+
+// Collects the samples of all sensors for a batch (add()), then solve()
+// fits one rigid motion - translation and rotation - to the displacements
+// the sensors saw at their mounting points, weighted least squares with
+// the surface quality as weight. Sensors below their min_squal or below
+// squal_pct % of the best squal are left out, and so is one that
+// saturated during the batch while another sensor is left. A sensor that
+// disagrees by more than reject_um with the motion is dropped and the
+// rest solved again; with two sensors that is the one with the lower
+// weight.
+// Rotation needs two sensors at different places; with one left the last
+// observed rotation per batch is kept until hold_ms (sample time) after
+// it was seen, then 0: the longer it is held, the more a changing turn
+// rate adds up.
+//
+// Everything after setup is integer: mounts become Q16 matrices, sums are
+// 64 bit, rotations are binary angles (see PoseTracker for the pose).
+class FlowFusion {
+  public:
+    FlowFusion(int32_t reject_um = 500);
+
+    int addSensor(const FlowMount &mount);
+
+    void add(int sensor, const MotionSample &s);
+    bool solve(FlowMotion &m);      // false if no sensor had data
+
+    int32_t reject_um;
+    uint8_t squal_pct;
+    uint16_t hold_ms;
+
+    // statistics
+    uint32_t batches;
+    uint32_t rejected;              // sensors dropped as outliers
+    uint32_t low_quality;           // sensors ignored for their squal
+    uint32_t saturated;             // sensors ignored for clipped counts
+    uint32_t no_rotation;           // batches with fewer than two sensors
+
+  private:
+    struct Sensor {
+      int32_t x_mm;
+      int32_t y_mm;
+      int32_t m[4];                 // counts -> um, Q16, row major
+      uint8_t weight;
+      uint8_t min_squal;
+      // current batch
+      int32_t dx;
+      int32_t dy;
+      uint32_t squal_sum;
+      uint16_t samples;
+      uint8_t flags;
+    };
+
+    Sensor _sensors[FUSION_MAX_SENSORS];
+    int _count;
+    int64_t _omega;                 // last observed rotation, urad per batch
+    uint32_t _omega_us;             // sample time it was observed at
+    uint32_t _t_us;                 // latest sample time
+
+    bool fit(const int32_t *vx, const int32_t *vy, const uint32_t *w, uint8_t used,
+             FlowMotion &m, int64_t &omega) const;
+};
+
+// sin of a binary angle, Q15
+int32_t fusion_sin(uint32_t angle);
+inline int32_t fusion_cos(uint32_t angle) { return fusion_sin(angle + 0x40000000u); }
+
+#endif  // __FLOWFUSION_H__
@@ -0,0 +1,61 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Common interface of the optical flow (mouse) sensors
+// ----------------------------------------------------------------------------
+
+#ifndef __FLOWSENSOR_H__
+#define __FLOWSENSOR_H__
+
+#include "hal.h"
+
+#define SAMPLE_SAT_X   0x01   // DX register hit its 8-bit limit
+#define SAMPLE_SAT_Y   0x02
+#define SAMPLE_MOTION  0x04   // sensor reported motion
+
+// one sensor reading with the time it was taken; dx/dy are in counts of
+// the sensor's highest resolution, whatever resolution it runs at
+struct MotionSample {
+  uint32_t t_us;
+  int16_t dx;
+  int16_t dy;
+  uint8_t squal;    // surface quality, 0 if the sensor has none
+  uint8_t flags;
+};
+
+inline uint8_t saturation_flags(int dx, int dy)
+{
+  return ((dx >= 127 || dx <= -128) ? SAMPLE_SAT_X : 0)
+       | ((dy >= 127 || dy <= -128) ? SAMPLE_SAT_Y : 0);
+}
+
+// CRTP base: a sensor driver derives from FlowSensor<itself> and provides
+//   bool readSample(MotionSample &s)   fill dx, dy, squal, flags
+//   void powerDown(), powerUp()        optional, the defaults do nothing
+// Code written against FlowSensor<S> (or a template on S) calls
+// sample(), which the compiler resolves and inlines per sensor type, no
+// virtual calls.
+template <class Sensor>
+class FlowSensor {
+  public:
+    bool sample(MotionSample &s) {
+      s.t_us = hal_micros();
+      return static_cast<Sensor *>(this)->readSample(s);
+    }
+
+    void sleep() { static_cast<Sensor *>(this)->powerDown(); }
+    void wake() { static_cast<Sensor *>(this)->powerUp(); }
+
+    // for sensors without a power down mode
+    void powerDown() {}
+    void powerUp() {}
+};
+
+// function pointer for type-erased users like the Sampler task, with the
+// whole sensor read inlined behind it
+template <class Sensor>
+bool read_sensor(void *sensor, MotionSample &s)
+{
+  return static_cast<Sensor *>(sensor)->sample(s);
+}
+
+#endif  // __FLOWSENSOR_H__
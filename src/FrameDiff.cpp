@@ -0,0 +1,36 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Dirty region tracking for the SSD1306 framebuffer
+// ----------------------------------------------------------------------------
+
+#include "FrameDiff.h"
+#include <string.h>
+
+int frame_diff(const uint8_t *frame, uint8_t *shown, PageSpan spans[OLED_PAGES])
+{
+  int bytes = 0;
+
+  for (int page = 0; page < OLED_PAGES; ++page) {
+    const uint8_t *f = frame + page * OLED_WIDTH;
+    uint8_t *s = shown + page * OLED_WIDTH;
+
+    int first = 0;
+    while (first < OLED_WIDTH && f[first] == s[first]) ++first;
+
+    if (first == OLED_WIDTH) {
+      spans[page].first = 1;
+      spans[page].last = 0;
+      continue;
+    }
+
+    int last = OLED_WIDTH - 1;
+    while (f[last] == s[last]) --last;
+
+    memcpy(s + first, f + first, last - first + 1);
+    spans[page].first = first;
+    spans[page].last = last;
+    bytes += last - first + 1;
+  }
+
+  return bytes;
+}
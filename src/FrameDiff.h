@@ -0,0 +1,28 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Dirty region tracking for the SSD1306 framebuffer
+// ----------------------------------------------------------------------------
+
+#ifndef __FRAMEDIFF_H__
+#define __FRAMEDIFF_H__
+
+#include <stdint.h>
+
+#define OLED_WIDTH  128
+#define OLED_PAGES  8     // 8 pixel rows per page
+#define OLED_BUFFER_SIZE (OLED_WIDTH * OLED_PAGES)
+
+// changed columns first..last of one page, empty if last < first
+struct PageSpan {
+  uint8_t first;
+  uint8_t last;
+  bool empty() const { return last < first; }
+  int length() const { return empty() ? 0 : last - first + 1; }
+};
+
+// Compares the framebuffer with the copy of what the display currently
+// shows, fills in the changed column span of every page and updates the
+// copy. Returns the number of data bytes that have to be sent.
+int frame_diff(const uint8_t *frame, uint8_t *shown, PageSpan spans[OLED_PAGES]);
+
+#endif  // __FRAMEDIFF_H__
@@ -0,0 +1,106 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Surface image capture pipeline and pixel frame encoder
+// ----------------------------------------------------------------------------
+
+#include "FramePipe.h"
+#include <stddef.h>
+
+FramePipe::FramePipe()
+{
+  for (uint8_t i = 0; i < FRAME_BUFFERS; ++i) _free.push(i);
+  _seq = 0;
+  captured = 0;
+  skipped = 0;
+  failed = 0;
+}
+
+PixelFrame *FramePipe::acquire()
+{
+  uint8_t i;
+  if (!_free.pop(i)) {
+    ++skipped;
+    return NULL;
+  }
+  return &_frames[i];
+}
+
+void FramePipe::publish(PixelFrame *f)
+{
+  f->seq = _seq++;
+  ++captured;
+  _full.push(f - _frames);
+}
+
+void FramePipe::discard(PixelFrame *f)
+{
+  ++failed;
+  _free.push(f - _frames);
+}
+
+PixelFrame *FramePipe::next()
+{
+  uint8_t i;
+  return _full.pop(i) ? &_frames[i] : NULL;
+}
+
+void FramePipe::release(PixelFrame *f)
+{
+  _free.push(f - _frames);
+}
+
+
+// predicted value of pixel i from its already known neighbors
+static inline uint8_t predict(const uint8_t *pixels, int i)
+{
+  if (i >= FRAME_SIDE) return pixels[i - FRAME_SIDE];
+  return i ? pixels[i - 1] : 0;
+}
+
+int frame_encode(const uint8_t *pixels, uint8_t *out)
+{
+  int len = 0;
+  int last = -1;
+  int run = 0;
+
+  for (int i = 0; i < FRAME_PIXELS; ++i) {
+    int d = (pixels[i] - predict(pixels, i)) & 0x7f;
+    if (d >= 64) d -= 128;
+    uint8_t z = (uint8_t)((d << 1) ^ (d >> 31)) & 0x7f;
+
+    if (z == last && run < 128) {
+      ++run;
+      continue;
+    }
+    if (run) out[len++] = 0x80 | (run - 1);
+    out[len++] = z;
+    last = z;
+    run = 0;
+  }
+  if (run) out[len++] = 0x80 | (run - 1);
+  return len;
+}
+
+bool frame_decode(const uint8_t *in, int len, uint8_t *pixels)
+{
+  int n = 0;
+  int last = -1;
+
+  for (int k = 0; k < len; ++k) {
+    int count = 1;
+    uint8_t z = in[k];
+    if (z & 0x80) {
+      if (last < 0) return false;
+      count = (z & 0x7f) + 1;
+      z = last;
+    }
+    last = z;
+    int d = (z >> 1) ^ -(z & 1);
+    while (count--) {
+      if (n == FRAME_PIXELS) return false;
+      pixels[n] = (predict(pixels, n) + d) & 0x7f;
+      ++n;
+    }
+  }
+  return n == FRAME_PIXELS;
+}
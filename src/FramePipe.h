@@ -0,0 +1,59 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Surface image capture pipeline and pixel frame encoder
+// ----------------------------------------------------------------------------
+
+#ifndef __FRAMEPIPE_H__
+#define __FRAMEPIPE_H__
+
+#include <stdint.h>
+#include "SpscRing.h"
+
+#define FRAME_SIDE     15
+#define FRAME_PIXELS   (FRAME_SIDE * FRAME_SIDE)
+#define FRAME_BUFFERS  4    // power of two for the rings
+
+struct PixelFrame {
+  uint32_t seq;
+  uint32_t t_us;
+  uint8_t pixels[FRAME_PIXELS];
+};
+
+// A fixed set of frame buffers passed between a capture task and a sender
+// through two lock-free rings, one of free and one of filled buffers. The
+// capture side fills a buffer while the sender still encodes the previous
+// one; when no buffer is free the capture is skipped and counted.
+class FramePipe {
+  public:
+    FramePipe();
+
+    // capture side
+    PixelFrame *acquire();            // NULL if all buffers are in use
+    void publish(PixelFrame *f);      // filled, hand it to the sender
+    void discard(PixelFrame *f);      // capture failed, back to free
+
+    // sender side
+    PixelFrame *next();               // NULL if nothing was captured
+    void release(PixelFrame *f);
+
+    // statistics
+    uint32_t captured;
+    uint32_t skipped;                 // no free buffer
+    uint32_t failed;                  // discarded captures
+
+  private:
+    PixelFrame _frames[FRAME_BUFFERS];
+    SpscRing<uint8_t, FRAME_BUFFERS> _free;
+    SpscRing<uint8_t, FRAME_BUFFERS> _full;
+    uint32_t _seq;
+};
+
+// 7-bit pixels as residuals against the pixel above (the left one in the
+// first row), wrapped to -64..63 and zigzagged to 0..127. An output byte
+// below 0x80 is one residual, 0x80 | n repeats the last residual n + 1
+// times. Never longer than FRAME_PIXELS bytes.
+int frame_encode(const uint8_t *pixels, uint8_t *out);
+// returns false on a malformed stream
+bool frame_decode(const uint8_t *in, int len, uint8_t *pixels);
+
+#endif  // __FRAMEPIPE_H__
@@ -0,0 +1,164 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Duty-cycle limited position reports over LoRa
+// ----------------------------------------------------------------------------
+
+#include "LoraReporter.h"
+
+#define LORA_BUSY_RETRY_MS 10
+#define LORA_TAG_FRAME     10   // bytes, see FleetFrame.h
+
+uint32_t lora_airtime_us(const LoraParams &radio, uint8_t payload)
+{
+  uint32_t tsym_us = ((uint64_t)1 << radio.sf) * 1000000 / radio.bw_hz;
+  int de = tsym_us > 16000 ? 1 : 0;     // low data rate optimization
+  int32_t num = 8 * payload - 4 * radio.sf + 28 + 16;
+  int32_t den = 4 * (radio.sf - 2 * de);
+  int32_t n = num > 0 ? (num + den - 1) / den * radio.cr : 0;
+  // preamble + 4.25 symbols, 8 header symbols and the payload, in quarters
+  uint32_t quarters = radio.preamble * 4 + 17 + (8 + n) * 4;
+  return (uint64_t)quarters * tsym_us / 4;
+}
+
+
+AirtimeBudget::AirtimeBudget(uint32_t duty_ppm, uint32_t burst_ms)
+{
+  this->duty_ppm = duty_ppm;
+  _capacity = (uint64_t)burst_ms * 1000 * 1000000;
+  _credit = _capacity;
+  _last_ms = 0;
+}
+
+void AirtimeBudget::refill(uint32_t now_ms)
+{
+  _credit += (uint64_t)(now_ms - _last_ms) * 1000 * duty_ppm;
+  if (_credit > _capacity) _credit = _capacity;
+  _last_ms = now_ms;
+}
+
+bool AirtimeBudget::afford(uint32_t airtime_us) const
+{
+  return _credit >= (uint64_t)airtime_us * 1000000;
+}
+
+void AirtimeBudget::spend(uint32_t airtime_us)
+{
+  uint64_t cost = (uint64_t)airtime_us * 1000000;
+  _credit = _credit > cost ? _credit - cost : 0;
+}
+
+uint32_t AirtimeBudget::wait_ms(uint32_t airtime_us) const
+{
+  uint64_t need = (uint64_t)airtime_us * 1000000;
+  if (_credit >= need) return 0;
+  uint64_t per_ms = (uint64_t)1000 * duty_ppm;
+  return (need - _credit + per_ms - 1) / per_ms;
+}
+
+
+LoraReporter::LoraReporter(SendFn send, void *ctx, uint8_t vehicle, const LoraParams &radio,
+                           uint32_t duty_ppm, uint32_t burst_ms, uint32_t pose_ms,
+                           uint32_t keepalive_ms)
+  : encoder(vehicle), budget(duty_ppm, burst_ms)
+{
+  _send = send;
+  _ctx = ctx;
+  _radio = radio;
+  enabled = true;
+  this->pose_ms = pose_ms;
+  this->keepalive_ms = keepalive_ms;
+  frames = bytes = 0;
+  airtime_us = 0;
+  coalesced = deferred = busy = tags_dropped = tag_wait_max_ms = 0;
+  _pose = Pose();
+  _pose_new = false;
+  _pose_sent_ms = 0;
+  _sent_heading = 0;
+  _sent_x = _sent_y = 0;
+  _tag_head = _tag_count = 0;
+}
+
+void LoraReporter::pose(const Pose &p)
+{
+  if (_pose_new) ++coalesced;
+  _pose = p;
+  _pose_new = true;
+}
+
+// the newest arrival counts, a full queue gives up the oldest
+void LoraReporter::tag(const Pose &p, uint16_t tag, uint32_t now_ms)
+{
+  if (!enabled) return;
+  if (_tag_count == LORA_TAG_QUEUE) {
+    _tag_head = (_tag_head + 1) % LORA_TAG_QUEUE;
+    --_tag_count;
+    ++tags_dropped;
+  }
+  TagArrival &t = _tags[(_tag_head + _tag_count) % LORA_TAG_QUEUE];
+  t.pose = p;
+  t.tag = tag;
+  t.t_ms = now_ms;
+  ++_tag_count;
+}
+
+bool LoraReporter::transmit(const uint8_t *frame, uint8_t len, uint32_t airtime)
+{
+  if (!_send(_ctx, frame, len)) {
+    ++busy;
+    return false;
+  }
+  encoder.sent();
+  budget.spend(airtime);
+  ++frames;
+  bytes += len;
+  airtime_us += airtime;
+  return true;
+}
+
+uint32_t LoraReporter::update(uint32_t now_ms)
+{
+  budget.refill(now_ms);
+  if (!enabled) {
+    _tag_count = 0;
+    return pose_ms;
+  }
+  uint8_t frame[FLEET_FRAME_MAX];
+
+  if (_tag_count > 0) {
+    TagArrival &t = _tags[_tag_head];
+    uint8_t len = encoder.encodeTag(t.pose, t.tag, frame);
+    uint32_t air = lora_airtime_us(_radio, len);
+    if (!budget.afford(air)) {
+      ++deferred;
+      return budget.wait_ms(air);
+    }
+    if (!transmit(frame, len, air)) return LORA_BUSY_RETRY_MS;
+    if (now_ms - t.t_ms > tag_wait_max_ms) tag_wait_max_ms = now_ms - t.t_ms;
+    _tag_head = (_tag_head + 1) % LORA_TAG_QUEUE;
+    --_tag_count;
+    return air / 1000 + 1;    // the next one after this is on the air
+  }
+
+  // a pose when it is due and moved or turned, or to keep alive
+  uint32_t since = now_ms - _pose_sent_ms;
+  if (since < pose_ms) return pose_ms - since;
+  int32_t x = _pose.x_um / 10000, y = _pose.y_um / 10000;
+  uint8_t heading = _pose.heading >> 24;
+  bool changed = _pose_new && (x != _sent_x || y != _sent_y || heading != _sent_heading);
+  if (!changed && since < keepalive_ms) return pose_ms;
+
+  uint8_t len = encoder.encode(_pose, frame);
+  uint32_t air = lora_airtime_us(_radio, len);
+  uint32_t reserve = lora_airtime_us(_radio, LORA_TAG_FRAME);
+  if (!budget.afford(air + reserve)) {
+    ++deferred;
+    return budget.wait_ms(air + reserve);
+  }
+  if (!transmit(frame, len, air)) return LORA_BUSY_RETRY_MS;
+  _pose_sent_ms = now_ms;
+  _pose_new = false;
+  _sent_x = x;
+  _sent_y = y;
+  _sent_heading = heading;
+  return pose_ms;
+}
@@ -0,0 +1,104 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Duty-cycle limited position reports over LoRa
+// ----------------------------------------------------------------------------
+
+#ifndef __LORAREPORTER_H__
+#define __LORAREPORTER_H__
+
+#include <stdint.h>
+#include "FleetFrame.h"
+
+#define LORA_TAG_QUEUE 4    // tag arrivals waiting for airtime
+
+// modulation, for the time on air
+struct LoraParams {
+  uint8_t sf;             // spreading factor 6..12
+  uint32_t bw_hz;
+  uint8_t cr;             // coding rate 4/cr, 5..8
+  uint8_t preamble;       // symbols
+};
+
+// time on air of an explicit-header packet with CRC (SX1276 datasheet)
+uint32_t lora_airtime_us(const LoraParams &radio, uint8_t payload);
+
+// Airtime credit: duty_ppm of the elapsed time flows in, up to burst_ms
+// worth. In any hour the radio is on the air at most
+// 3600 s * duty_ppm / 1e6 + burst_ms, so for the 1% of the 868 MHz band
+// a duty of 0.9% leaves room for a 2 s burst.
+class AirtimeBudget {
+  public:
+    AirtimeBudget(uint32_t duty_ppm, uint32_t burst_ms);
+
+    void refill(uint32_t now_ms);
+    bool afford(uint32_t airtime_us) const;
+    void spend(uint32_t airtime_us);
+    uint32_t wait_ms(uint32_t airtime_us) const;   // until afford() is true
+
+    uint32_t duty_ppm;
+
+  private:
+    uint64_t _credit;       // us of airtime * 1e6
+    uint64_t _capacity;
+    uint32_t _last_ms;
+};
+
+// Coalesces updates into what the airtime allows: only the newest pose is
+// kept, sent at most every pose_ms when it changed (at least every
+// keepalive_ms), tag arrivals queue ahead of it. A pose goes out only if
+// the credit left afterwards still covers a tag frame, so a tag never
+// waits for poses. send() hands a frame to the radio and returns false
+// while the radio is still busy with the last one.
+class LoraReporter {
+  public:
+    typedef bool (*SendFn)(void *ctx, const uint8_t *data, uint8_t len);
+
+    LoraReporter(SendFn send, void *ctx, uint8_t vehicle, const LoraParams &radio,
+                 uint32_t duty_ppm, uint32_t burst_ms, uint32_t pose_ms,
+                 uint32_t keepalive_ms = 60000);
+
+    void pose(const Pose &p);
+    void tag(const Pose &p, uint16_t tag, uint32_t now_ms);
+    uint32_t update(uint32_t now_ms);   // ms until the next update is due
+
+    bool enabled;           // false: keep coalescing, send nothing
+    uint32_t pose_ms;
+    uint32_t keepalive_ms;
+
+    FleetEncoder encoder;
+    AirtimeBudget budget;
+
+    // statistics
+    uint32_t frames;
+    uint32_t bytes;
+    uint64_t airtime_us;
+    uint32_t coalesced;     // poses replaced before they went out
+    uint32_t deferred;      // updates that waited for airtime
+    uint32_t busy;          // radio still transmitting
+    uint32_t tags_dropped;  // tag queue full
+    uint32_t tag_wait_max_ms;
+
+  private:
+    SendFn _send;
+    void *_ctx;
+    LoraParams _radio;
+
+    Pose _pose;
+    bool _pose_new;
+    uint32_t _pose_sent_ms;
+    uint8_t _sent_heading;
+    int32_t _sent_x, _sent_y;
+
+    struct TagArrival {
+      Pose pose;
+      uint16_t tag;
+      uint32_t t_ms;
+    };
+    TagArrival _tags[LORA_TAG_QUEUE];
+    uint8_t _tag_head;
+    uint8_t _tag_count;
+
+    bool transmit(const uint8_t *frame, uint8_t len, uint32_t airtime);
+};
+
+#endif  // __LORAREPORTER_H__
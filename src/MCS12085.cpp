@@ -4,13 +4,9 @@
 // ----------------------------------------------------------------------------
 
 #include "MCS12085.h"
-#include "Arduino.h"
+#include "hal.h"
 // #include <Print.h>
 
-// The time of a clock pulse. This will be used twice to make the clock
-// signal: cycle us low and then cycle us high
-#define MCS12085_CYCLE 25
-
 MCS12085::MCS12085(uint8_t sck, uint8_t sdio) {
   _sck = sck;
   _sdio = sdio;
@@ -21,25 +17,25 @@ MCS12085::MCS12085(uint8_t sck, uint8_t sdio) {
 void MCS12085::init()
 {
   // When not being clocked the clock pin needs to be high
-  pinMode(_sck, OUTPUT);
-  digitalWrite(_sck, HIGH);
+  hal_pin_mode(_sck, OUTPUT);
+  hal_write(_sck, HIGH);
 
-  pinMode(_sdio, OUTPUT);
-  digitalWrite(_sdio, LOW);
+  hal_pin_mode(_sdio, OUTPUT);
+  hal_write(_sdio, LOW);
 }
 
 // perform a single clock tick of 25us low
 void MCS12085::tick()
 {
-  digitalWrite(_sck, LOW);
-  delayMicroseconds(MCS12085_CYCLE);
-  digitalWrite(_sck, HIGH);
+  hal_write(_sck, LOW);
+  hal_delay_us(MCS12085_CYCLE);
+  hal_write(_sck, HIGH);
 }
 
 // finish the clock pulse by waiting during the high period
 void MCS12085::tock()
 {
-  delayMicroseconds(MCS12085_CYCLE);
+  hal_delay_us(MCS12085_CYCLE);
 }
 
 // read a single bit from the chip by creating a clock
@@ -48,7 +44,7 @@ int MCS12085::read_bit()
 {
   tick();
 
-  int r = (digitalRead(_sdio) == HIGH);
+  int r = (hal_read(_sdio) == HIGH);
 
   tock();
   return r;
@@ -70,8 +66,8 @@ byte MCS12085::read_byte()
     --bits;
   }
 
-  pinMode(_sdio, OUTPUT);
-  digitalWrite(_sdio, LOW);
+  hal_pin_mode(_sdio, OUTPUT);
+  hal_write(_sdio, LOW);
 
   return b;
 }
@@ -83,14 +79,14 @@ void MCS12085::write_bit(byte b)    // 1 or 0
   // Set the data pin value ready for the write and then clock
 
   if ( b ) {
-    digitalWrite(_sdio, HIGH);
+    hal_write(_sdio, HIGH);
   } else {
-    digitalWrite(_sdio, LOW);
+    hal_write(_sdio, LOW);
   }
 
   tick();
   tock();
-  digitalWrite(_sdio, LOW);
+  hal_write(_sdio, LOW);
 }
 
 // write a byte to the sensor MSB first
@@ -104,19 +100,19 @@ void MCS12085::write_byte(byte w)      // Number to get the bits from
     --bits;
   }
 
-  pinMode(_sdio, INPUT);
+  hal_pin_mode(_sdio, INPUT);
 }
 
 // pause between a write and a read to the sensor
 void MCS12085::wr_pause()
 {
-  delayMicroseconds(100);
+  hal_delay_us(MCS12085_T_SRAD);
 }
 
 // pause between a read and a write to the sensor
 void MCS12085::rw_pause()
 {
-  delayMicroseconds(250);
+  hal_delay_us(MCS12085_T_SRX);
 }
 
 // converts a byte into a signed 8-bit int
@@ -129,24 +125,37 @@ int MCS12085::convert(byte b)
   }
 }
 
-// read the change in X position since last read
-int MCS12085::read_x()
+// a complete register read: command, tSRAD, data, tSRX
+byte MCS12085::read_register(byte reg)
 {
-  write_byte(0x02); // 0x02 = Read DX Register
+  write_byte(reg);
   wr_pause();
-  int i = convert(read_byte());
+  byte b = read_byte();
   rw_pause();
-  return i;
+  return b;
+}
+
+// read the change in X position since last read
+int MCS12085::read_x()
+{
+  return convert(read_register(0x02)); // 0x02 = Read DX Register
 }
 
 // read the change in Y position since last read
 int MCS12085::read_y()
 {
-  write_byte(0x03); // 0x03 = Read DY Register
-  wr_pause();
-  int i = convert(read_byte());
-  rw_pause();
-  return i;
+  return convert(read_register(0x03)); // 0x03 = Read DY Register
+}
+
+// read both deltas back to back. The chip has no burst mode, so this is
+// two full register reads, each with its MCS12085_T_SRX (250 us) gap:
+// one call instead of two, not faster than read_x() and read_y().
+MCS12085::Delta MCS12085::read_xy()
+{
+  Delta d;
+  d.dx = (int8_t)read_register(0x02);
+  d.dy = (int8_t)read_register(0x03);
+  return d;
 }
 
 
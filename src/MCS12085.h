@@ -6,7 +6,19 @@
 #ifndef __MCS12085_H__
 #define __MCS12085_H__
 
-#include "Arduino.h"
+#include "hal.h"
+#include "FlowSensor.h"
+
+// The time of a clock pulse. This will be used twice to make the clock
+// signal: cycle us low and then cycle us high
+#define MCS12085_CYCLE 25
+
+// serial port timing (us). tSRAD as in the original driver. tSRX would be
+// 250 ns if the port is really ADNS-2051 compatible, but that is only
+// checked against the simulator, not on hardware: keep the original
+// driver's 250 us until it is.
+#define MCS12085_T_SRAD 100 // command to first read clock
+#define MCS12085_T_SRX  250 // from the end of a read to the next command
 
 
 // MCS-12085 optical mouse sensor
@@ -14,13 +26,30 @@
 // see http://rogerrowland.blogspot.com/2014/06/hacking-optical-mouse.html
 // datasheet http://www.rmrsystems.co.uk/download/MCS12085.pdf
 
-class MCS12085 {
+class MCS12085 : public FlowSensor<MCS12085> {
   public:
+    // motion since the last read, in counts
+    struct Delta {
+      int8_t dx;
+      int8_t dy;
+    };
+
     MCS12085(uint8_t sck, uint8_t sdio);
 
     void init();    
     int read_x();
     int read_y();
+    Delta read_xy();
+
+    // FlowSensor: both deltas, the chip has no quality register
+    bool readSample(MotionSample &s) {
+      Delta d = read_xy();
+      s.dx = d.dx;
+      s.dy = d.dy;
+      s.squal = 0;
+      s.flags = saturation_flags(d.dx, d.dy) | ((d.dx || d.dy) ? SAMPLE_MOTION : 0);
+      return true;
+    }
     
   private:   
     uint8_t _sck;
@@ -35,6 +64,7 @@ class MCS12085 {
     void wr_pause();
     void rw_pause();
     int convert(byte);
+    byte read_register(byte reg);
 
   
 };
@@ -0,0 +1,123 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Odometer, MCS-12085 driver specialized on pins and timing at compile time
+// ----------------------------------------------------------------------------
+
+#ifndef __MCS12085FAST_H__
+#define __MCS12085FAST_H__
+
+#include "hal.h"
+#include "MCS12085.h"
+
+// Serial port timing profiles (ns). The chip samples SDIO on the rising
+// edge and shifts read data out on the falling edge, so the low phase has
+// to cover the SDIO output delay.
+
+// the timing of the MCS12085 class: MCS12085_CYCLE us low and high
+struct MCS12085TimingLegacy {
+  static const uint32_t clk_low_ns = MCS12085_CYCLE * 1000;
+  static const uint32_t clk_high_ns = MCS12085_CYCLE * 1000;
+  static const uint32_t srad_ns = MCS12085_T_SRAD * 1000;
+  static const uint32_t srx_ns = MCS12085_T_SRX * 1000;
+};
+
+// datasheet minimums (ADNS-2051 compatible port, fSCLK <= 10 MHz,
+// tDLY-SDIO <= 120 ns) with some margin; tSRX stays at MCS12085_T_SRX
+// until the 250 ns minimum is checked on hardware
+struct MCS12085TimingFast {
+  static const uint32_t clk_low_ns = 150;
+  static const uint32_t clk_high_ns = 100;
+  static const uint32_t srad_ns = 100000;
+  static const uint32_t srx_ns = MCS12085_T_SRX * 1000;
+};
+
+// Same protocol as MCS12085, but SCK/SDIO are template parameters so every
+// pin access compiles to a single GPIO register store, and the gaps are
+// cycle-counted instead of whole microseconds.
+template <uint8_t SCK, uint8_t SDIO, class T = MCS12085TimingFast>
+class MCS12085Fast : public FlowSensor<MCS12085Fast<SCK, SDIO, T> > {
+  public:
+    typedef MCS12085::Delta Delta;
+
+    // set up the pins for the clock and data
+    void init() {
+      // When not being clocked the clock pin needs to be high
+      hal_pin_mode(SCK, OUTPUT);
+      hal_write(SCK, HIGH);
+
+      hal_pin_mode(SDIO, OUTPUT);
+      hal_write(SDIO, LOW);
+    }
+
+    // read the change in X position since last read
+    int read_x() { return (int8_t)read_register(0x02); }
+
+    // read the change in Y position since last read
+    int read_y() { return (int8_t)read_register(0x03); }
+
+    // read both deltas back to back
+    Delta read_xy() {
+      Delta d;
+      d.dx = (int8_t)read_register(0x02);
+      d.dy = (int8_t)read_register(0x03);
+      return d;
+    }
+
+    // FlowSensor: both deltas, the chip has no quality register
+    bool readSample(MotionSample &s) {
+      Delta d = read_xy();
+      s.dx = d.dx;
+      s.dy = d.dy;
+      s.squal = 0;
+      s.flags = saturation_flags(d.dx, d.dy) | ((d.dx || d.dy) ? SAMPLE_MOTION : 0);
+      return true;
+    }
+
+  private:
+    typedef HalPin<SCK> Sck;
+    typedef HalPin<SDIO> Sdio;
+
+    byte read_register(byte reg) {
+      write_byte(reg);
+      delay(T::srad_ns);
+      byte b = read_byte();
+      delay(T::srx_ns);
+      return b;
+    }
+
+    static inline void delay(uint32_t ns) {
+      if (ns >= 10000) hal_delay_us(ns / 1000);
+      else hal_delay_ns(ns);
+    }
+
+    // Writes 8 bits MSB first, the chip samples on the rising edge
+    void write_byte(byte w) {
+      Sdio::output();
+      for (byte mask = 0x80; mask; mask >>= 1) {
+        Sdio::write(w & mask);
+        Sck::low();
+        delay(T::clk_low_ns);
+        Sck::high();
+        delay(T::clk_high_ns);
+      }
+      Sdio::low();
+      Sdio::input();
+    }
+
+    // Reads 8 bits MSB first, data is valid from the end of the low phase
+    // until after the rising edge
+    byte read_byte() {
+      byte b = 0;
+      for (byte mask = 0x80; mask; mask >>= 1) {
+        Sck::low();
+        delay(T::clk_low_ns);
+        Sck::high();
+        if (Sdio::read()) b |= mask;
+        delay(T::clk_high_ns);
+      }
+      // SDIO is taken back by the next write_byte(), after tSRX
+      return b;
+    }
+};
+
+#endif  // __MCS12085FAST_H__
@@ -0,0 +1,50 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Lock-free latest-value mailbox between two tasks
+// ----------------------------------------------------------------------------
+
+#ifndef __MAILBOX_H__
+#define __MAILBOX_H__
+
+#include <stdint.h>
+#include <atomic>
+
+// One task posts, another takes; only the newest value is kept. Triple
+// buffered: the writer fills its private slot and swaps it with the shared
+// one, the reader swaps the shared slot with its own. Neither side ever
+// waits or sees a half-written value. A post over an untaken value
+// replaces it and is counted as dropped.
+template <typename T>
+class Mailbox {
+  public:
+    Mailbox() : _write(0), _read(1), _shared(2), _dropped(0) {}
+
+    // writer side, never blocks
+    void post(const T &value) {
+      _buf[_write] = value;
+      uint8_t old = _shared.exchange(_write | FRESH, std::memory_order_acq_rel);
+      if (old & FRESH) _dropped.fetch_add(1, std::memory_order_relaxed);
+      _write = old & SLOT;
+    }
+
+    // reader side: false if nothing new was posted since the last take
+    bool take(T &out) {
+      if (!(_shared.load(std::memory_order_relaxed) & FRESH)) return false;
+      _read = _shared.exchange(_read, std::memory_order_acq_rel) & SLOT;
+      out = _buf[_read];
+      return true;
+    }
+
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+  private:
+    enum { SLOT = 0x03, FRESH = 0x04 };
+
+    T _buf[3];
+    uint8_t _write;                 // writer's slot
+    uint8_t _read;                  // reader's slot
+    std::atomic<uint8_t> _shared;   // slot in the middle, FRESH if unread
+    std::atomic<uint32_t> _dropped;
+};
+
+#endif  // __MAILBOX_H__
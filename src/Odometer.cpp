@@ -0,0 +1,90 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Fixed-point odometry accumulator
+// ----------------------------------------------------------------------------
+
+#include "Odometer.h"
+
+// step lengths for |dx|, |dy| < ODO_TABLE_SIZE, built on first use.
+// Triangular layout (larger component first), 8 KB.
+#define ODO_TABLE_SIZE 64
+
+static uint32_t step_table[ODO_TABLE_SIZE * (ODO_TABLE_SIZE + 1) / 2];
+static bool step_table_ready = false;
+
+static inline int step_index(uint32_t big, uint32_t small)
+{
+  return big * (big + 1) / 2 + small;
+}
+
+// round(sqrt(n) * 2^16) for n <= 2^31, digit by digit: one result bit per
+// step, 16 integer and 16 fraction bits. The remainder stays below
+// 2 * root + 1 < 2^33, so it takes 64 bits; the root fits 32.
+static uint32_t sqrt_q16(uint32_t n)
+{
+  uint32_t root = 0;
+  uint64_t rem = 0;
+
+  for (int i = 0; i < 16 + ODO_FRAC_BITS; ++i) {
+    rem = (rem << 2) | ((n >> 30) & 3);
+    n <<= 2;
+    uint64_t test = ((uint64_t)root << 2) | 1;
+    uint64_t ge = -(uint64_t)(rem >= test);
+    rem -= test & ge;
+    root = (root << 1) | (uint32_t)(ge & 1);
+  }
+
+  // rem = N - root^2; round up if N > (root + 1/2)^2
+  if (rem > root) ++root;
+  return root;
+}
+
+static uint32_t step_exact(uint32_t ax, uint32_t ay)
+{
+  return sqrt_q16(ax * ax + ay * ay);
+}
+
+static void build_step_table()
+{
+  for (int x = 0; x < ODO_TABLE_SIZE; ++x)
+    for (int y = 0; y <= x; ++y)
+      step_table[step_index(x, y)] = step_exact(x, y);
+  step_table_ready = true;
+}
+
+Odometer::Odometer(uint32_t counts_per_m)
+{
+  _total = 0;
+  _counts_per_m = counts_per_m;
+}
+
+uint32_t Odometer::step_q16(int dx, int dy)
+{
+  uint32_t ax = dx < 0 ? -(uint32_t)dx : dx;
+  uint32_t ay = dy < 0 ? -(uint32_t)dy : dy;
+  if (ax > ODO_STEP_MAX) ax = ODO_STEP_MAX;
+  if (ay > ODO_STEP_MAX) ay = ODO_STEP_MAX;
+
+  if (ay == 0) return ax << ODO_FRAC_BITS;
+  if (ax == 0) return ay << ODO_FRAC_BITS;
+  if (ax < ODO_TABLE_SIZE && ay < ODO_TABLE_SIZE) {
+    if (!step_table_ready) build_step_table();
+    uint32_t big = ax > ay ? ax : ay;
+    uint32_t small = ax ^ ay ^ big;
+    return step_table[step_index(big, small)];
+  }
+  return step_exact(ax, ay);
+}
+
+void Odometer::add(int dx, int dy)
+{
+  _total += step_q16(dx, dy);
+}
+
+// travelled distance in mm
+uint64_t Odometer::mm() const
+{
+  uint64_t q = _total / _counts_per_m;
+  uint64_t r = _total % _counts_per_m;
+  return (q * 1000 + r * 1000 / _counts_per_m) >> ODO_FRAC_BITS;
+}
@@ -0,0 +1,41 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Fixed-point odometry accumulator
+// ----------------------------------------------------------------------------
+
+#ifndef __ODOMETER_H__
+#define __ODOMETER_H__
+
+#include <stdint.h>
+
+#define ODO_FRAC_BITS 16
+#define ODO_ONE       ((uint64_t)1 << ODO_FRAC_BITS)
+#define ODO_STEP_MAX  32768     // per axis, larger steps are clamped
+
+// Sums the travelled path length sqrt(dx^2 + dy^2) of each sensor sample
+// in Q48.16 counts. The fractional part of every step is kept instead of
+// being truncated per sample, and each step is rounded to the nearest
+// 1/65536 count, so the total stays unbiased over arbitrarily long runs.
+// No floating point: axis-aligned steps are exact shifts, small steps come
+// from a lookup table and the rest from an integer square root.
+class Odometer {
+  public:
+    Odometer(uint32_t counts_per_m);
+
+    void add(int dx, int dy);
+    void reset() { _total = 0; }
+
+    uint64_t total_q16() const { return _total; }
+    uint64_t counts() const { return _total >> ODO_FRAC_BITS; }
+    uint64_t mm() const;
+
+    // length of one step in Q16 counts, rounded to nearest; any int16
+    // step is exact, beyond that each axis is clamped to ODO_STEP_MAX
+    static uint32_t step_q16(int dx, int dy);
+
+  private:
+    uint64_t _total;
+    uint32_t _counts_per_m;
+};
+
+#endif  // __ODOMETER_H__
@@ -0,0 +1,97 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Vehicle pose from the flow sensor motion and position fixes
+// ----------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+#include "Pose.h"
+
+static uint32_t isqrt64(uint64_t n)
+{
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > n) bit >>= 2;
+  while (bit) {
+    if (n >= root + bit) {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+// binary angle per us -> mrad/s, 2pi / 2^32 * 1e9
+#define BAM_US_TO_MRAD_S 1.46291808
+
+PoseTracker::PoseTracker()
+{
+  heading_fixes = 0;
+  reset();
+}
+
+void PoseTracker::reset(int32_t x_mm, int32_t y_mm, uint32_t heading)
+{
+  memset(&_pose, 0, sizeof(_pose));
+  _pose.x_um = (int64_t)x_mm * 1000;
+  _pose.y_um = (int64_t)y_mm * 1000;
+  _pose.heading = heading;
+  _fixed = false;
+}
+
+void PoseTracker::update(const FlowMotion &m, uint32_t t_us)
+{
+  Pose &p = _pose;
+
+  int32_t dt = (int32_t)(t_us - p.t_us);
+  if (p.updates && dt > 0) {
+    p.v_fwd_mm_s = (int32_t)((int64_t)m.dx_um * 1000 / dt);
+    p.v_left_mm_s = (int32_t)((int64_t)m.dy_um * 1000 / dt);
+    p.omega_mrad_s = (int32_t)(m.dtheta * BAM_US_TO_MRAD_S / dt);
+  }
+
+  // turn the translation by the heading halfway through the motion
+  uint32_t mid = p.heading + (uint32_t)(m.dtheta / 2);
+  int64_t c = fusion_cos(mid);
+  int64_t s = fusion_sin(mid);
+  p.x_um += (c * m.dx_um - s * m.dy_um) >> 15;
+  p.y_um += (s * m.dx_um + c * m.dy_um) >> 15;
+  p.heading += (uint32_t)m.dtheta;
+  p.fwd_um += m.dx_um;
+  p.left_um += m.dy_um;
+  p.path_um += isqrt64((uint64_t)((int64_t)m.dx_um * m.dx_um + (int64_t)m.dy_um * m.dy_um));
+  p.t_us = t_us;
+  ++p.updates;
+
+  _shared.write(p);
+}
+
+void PoseTracker::fix(int32_t x_mm, int32_t y_mm, uint32_t t_us)
+{
+  Pose &p = _pose;
+
+  if (_fixed) {
+    // way between the fixes: as driven by the odometry and the true one
+    float ox = p.x_um / 1000.0f - _fix_x_mm, oy = p.y_um / 1000.0f - _fix_y_mm;
+    float tx = x_mm - _fix_x_mm, ty = y_mm - _fix_y_mm;
+    if (hypotf(tx, ty) >= POSE_FIX_MIN_MM && hypotf(ox, oy) >= POSE_FIX_MIN_MM / 2) {
+      float error = atan2f(ty, tx) - atan2f(oy, ox);
+      p.heading += (uint32_t)(int32_t)lrintf(remainderf(error, 2 * (float)M_PI) *
+                                             (float)FUSION_BAM_PER_RAD);
+      ++heading_fixes;
+    }
+  }
+
+  p.x_um = (int64_t)x_mm * 1000;
+  p.y_um = (int64_t)y_mm * 1000;
+  if (!p.updates) p.t_us = t_us;
+  ++p.fixes;
+  _fixed = true;
+  _fix_x_mm = x_mm;
+  _fix_y_mm = y_mm;
+
+  _shared.write(p);
+}
@@ -0,0 +1,62 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Vehicle pose from the flow sensor motion and position fixes
+// ----------------------------------------------------------------------------
+
+#ifndef __POSE_H__
+#define __POSE_H__
+
+#include <stdint.h>
+#include "FlowFusion.h"
+#include "SeqLock.h"
+
+#define POSE_FIX_MIN_MM 200  // fixes closer together don't correct the heading
+
+// where the vehicle is, how it got there and how fast it goes
+struct Pose {
+  uint32_t t_us;                  // time of the last update
+  uint32_t heading;               // binary angle, 0 along the world x axis
+  int64_t x_um;                   // world frame
+  int64_t y_um;
+  int64_t fwd_um;                 // vehicle frame: signed travel along its axes,
+  int64_t left_um;                // backing up counts back
+  uint64_t path_um;               // travelled in any direction
+  int32_t v_fwd_mm_s;             // vehicle frame velocity over the last update
+  int32_t v_left_mm_s;
+  int32_t omega_mrad_s;
+  uint32_t updates;
+  uint32_t fixes;                 // position fixes applied
+};
+
+// Integrates the FlowFusion motion into a pose; fix() puts the vehicle
+// at a known place (an RFID tag with coordinates). Two fixes far enough
+// apart also correct the heading by the angle between the way the
+// odometry saw and the way between the tags.
+//
+// One task updates, any task can read() a consistent copy through a
+// seqlock without ever holding up the writer.
+class PoseTracker {
+  public:
+    PoseTracker();
+
+    // writer side
+    void update(const FlowMotion &m, uint32_t t_us);
+    void fix(int32_t x_mm, int32_t y_mm, uint32_t t_us);
+    void reset(int32_t x_mm = 0, int32_t y_mm = 0, uint32_t heading = 0);
+    const Pose &pose() const { return _pose; }
+
+    // any task: false before the first update
+    bool read(Pose &p) const { return _shared.read(p); }
+    uint32_t read_retries() const { return _shared.retries(); }
+
+    uint32_t heading_fixes;
+
+  private:
+    Pose _pose;
+    SeqLock<Pose> _shared;
+    bool _fixed;
+    int32_t _fix_x_mm;
+    int32_t _fix_y_mm;
+};
+
+#endif  // __POSE_H__
@@ -0,0 +1,87 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Idle detection and low-power states
+// ----------------------------------------------------------------------------
+
+#include "PowerManager.h"
+
+static const char *state_names[POWER_STATES] = { "active", "slow", "sleep", "probe" };
+
+const char *power_state_name(PowerState state)
+{
+  return state < POWER_STATES ? state_names[state] : "?";
+}
+
+PowerManager::PowerManager(ApplyFn apply, CheckFn check, void *ctx,
+                           uint32_t slow_after_ms, uint32_t sleep_after_ms,
+                           uint32_t check_ms, uint32_t probe_ms)
+{
+  _apply = apply;
+  _check = check;
+  _ctx = ctx;
+  this->slow_after_ms = slow_after_ms;
+  this->sleep_after_ms = sleep_after_ms;
+  this->check_ms = check_ms;
+  this->probe_ms = probe_ms;
+  for (int i = 0; i < POWER_STATES; ++i) state_ms[i] = 0;
+  checks = wakeups = 0;
+  _state = POWER_ACTIVE;
+  _activity_ms = _entered_ms = _last_ms = 0;
+}
+
+void PowerManager::account(uint32_t now_ms)
+{
+  state_ms[_state] += now_ms - _last_ms;
+  _last_ms = now_ms;
+}
+
+void PowerManager::enter(PowerState state, uint32_t now_ms)
+{
+  account(now_ms);
+  _state = state;
+  _entered_ms = now_ms;
+  _apply(_ctx, state);
+}
+
+void PowerManager::activity(uint32_t now_ms)
+{
+  _activity_ms = now_ms;
+  if (_state != POWER_ACTIVE) enter(POWER_ACTIVE, now_ms);
+}
+
+uint32_t PowerManager::update(uint32_t now_ms)
+{
+  account(now_ms);
+  uint32_t idle = now_ms - _activity_ms;
+  uint32_t in_state = now_ms - _entered_ms;
+
+  switch (_state) {
+    case POWER_ACTIVE:
+      if (idle < slow_after_ms) return slow_after_ms - idle;
+      enter(POWER_SLOW, now_ms);
+      // fall through
+    case POWER_SLOW:
+      if (idle < sleep_after_ms) return sleep_after_ms - idle;
+      enter(POWER_SLEEP, now_ms);
+      return check_ms;
+
+    case POWER_SLEEP:
+      if (in_state < check_ms) return check_ms - in_state;
+      enter(POWER_PROBE, now_ms);
+      in_state = 0;
+      // fall through
+    case POWER_PROBE:
+      if (in_state < probe_ms) return probe_ms - in_state;
+      ++checks;
+      if (_check(_ctx)) {
+        ++wakeups;
+        activity(now_ms);
+        return slow_after_ms;
+      }
+      enter(POWER_SLEEP, now_ms);
+      return check_ms;
+
+    default:
+      return check_ms;
+  }
+}
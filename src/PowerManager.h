@@ -0,0 +1,68 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Idle detection and low-power states
+// ----------------------------------------------------------------------------
+
+#ifndef __POWERMANAGER_H__
+#define __POWERMANAGER_H__
+
+#include <stdint.h>
+
+enum PowerState {
+  POWER_ACTIVE,     // full polling rates
+  POWER_SLOW,       // stepped down polling
+  POWER_SLEEP,      // sensor powered down, RF field off, CPU light sleeping
+  POWER_PROBE,      // asleep, sensor powered up for a motion check
+  POWER_STATES
+};
+
+const char *power_state_name(PowerState state);
+
+// ACTIVE while something happens (activity()), SLOW after slow_after_ms
+// without activity, SLEEP after sleep_after_ms. Asleep, the sensor is
+// powered up every check_ms (PROBE) and probe_ms later - the time it needs
+// to see motion again - check() decides: back to ACTIVE, or SLEEP again.
+// Motion is therefore noticed within check_ms + probe_ms.
+//
+// The manager only keeps time; apply() makes a state real (polling rates,
+// sensor and RF power). update() returns when it wants to run again, the
+// CPU may sleep until then.
+class PowerManager {
+  public:
+    typedef void (*ApplyFn)(void *ctx, PowerState state);
+    typedef bool (*CheckFn)(void *ctx);
+
+    PowerManager(ApplyFn apply, CheckFn check, void *ctx,
+                 uint32_t slow_after_ms, uint32_t sleep_after_ms,
+                 uint32_t check_ms, uint32_t probe_ms);
+
+    void activity(uint32_t now_ms);     // motion, a tag: back to ACTIVE
+    uint32_t update(uint32_t now_ms);   // ms until the next update is due
+
+    PowerState state() const { return _state; }
+    bool asleep() const { return _state >= POWER_SLEEP; }
+
+    uint32_t slow_after_ms;
+    uint32_t sleep_after_ms;
+    uint32_t check_ms;
+    uint32_t probe_ms;
+
+    // statistics
+    uint32_t state_ms[POWER_STATES];    // time spent in each state
+    uint32_t checks;
+    uint32_t wakeups;                   // checks that found motion
+
+  private:
+    ApplyFn _apply;
+    CheckFn _check;
+    void *_ctx;
+    PowerState _state;
+    uint32_t _activity_ms;
+    uint32_t _entered_ms;
+    uint32_t _last_ms;
+
+    void account(uint32_t now_ms);
+    void enter(PowerState state, uint32_t now_ms);
+};
+
+#endif  // __POWERMANAGER_H__
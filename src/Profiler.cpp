@@ -0,0 +1,105 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Scoped stage timers with log-bucketed histograms
+// ----------------------------------------------------------------------------
+
+#include "Profiler.h"
+#include <stdio.h>
+
+#ifndef ARDUINO
+#include <chrono>
+
+uint32_t prof_ticks()
+{
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+ProfStage *ProfStage::first = NULL;
+
+ProfStage::ProfStage(const char *name)
+{
+  this->name = name;
+  reset();
+
+  // the sampler task and loop() may meet their first PROFILE_SCOPE at the
+  // same time on two cores: push with compare-and-swap so neither is lost
+  ProfStage *head = __atomic_load_n(&first, __ATOMIC_RELAXED);
+  do {
+    next = head;
+  } while (!__atomic_compare_exchange_n(&first, &head, this, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void ProfStage::reset()
+{
+  count = 0;
+  max_ticks = 0;
+  total_ticks = 0;
+  for (int i = 0; i < PROF_BUCKETS; ++i) _buckets[i] = 0;
+}
+
+// values below 2^SUB_BITS get a bucket each, above that the bucket is the
+// position of the top bit plus the SUB_BITS bits below it
+static inline int bucket_of(uint32_t t)
+{
+  if (t < (1u << PROF_SUB_BITS)) return t;
+  int msb = 31 - __builtin_clz(t);
+  int sub = (t >> (msb - PROF_SUB_BITS)) & ((1 << PROF_SUB_BITS) - 1);
+  return ((msb - PROF_SUB_BITS + 1) << PROF_SUB_BITS) + sub;
+}
+
+// largest value that falls into a bucket
+static inline uint32_t bucket_top(int b)
+{
+  if (b < (1 << PROF_SUB_BITS)) return b;
+  int msb = (b >> PROF_SUB_BITS) + PROF_SUB_BITS - 1;
+  uint32_t sub = b & ((1 << PROF_SUB_BITS) - 1);
+  uint64_t low = ((uint64_t)((1 << PROF_SUB_BITS) | sub)) << (msb - PROF_SUB_BITS);
+  return (uint32_t)(low + ((uint64_t)1 << (msb - PROF_SUB_BITS)) - 1);
+}
+
+void ProfStage::record(uint32_t ticks)
+{
+  ++_buckets[bucket_of(ticks)];
+  ++count;
+  total_ticks += ticks;
+  if (ticks > max_ticks) max_ticks = ticks;
+}
+
+uint32_t ProfStage::percentile(float p) const
+{
+  if (count == 0) return 0;
+  uint32_t want = (uint32_t)(p * count + 0.5f);
+  if (want == 0) want = 1;
+  uint32_t seen = 0;
+  for (int b = 0; b < PROF_BUCKETS; ++b) {
+    seen += _buckets[b];
+    if (seen >= want) {
+      uint32_t top = bucket_top(b);
+      return top < max_ticks ? top : max_ticks;
+    }
+  }
+  return max_ticks;
+}
+
+void profiler_dump()
+{
+  char line[96];
+  Serial.println("stage              count      p50 us      p99 us      max us");
+  for (ProfStage *s = __atomic_load_n(&ProfStage::first, __ATOMIC_ACQUIRE); s; s = s->next) {
+    snprintf(line, sizeof(line), "%-14s %9lu %11.1f %11.1f %11.1f",
+             s->name, (unsigned long)s->count,
+             (double)s->percentile(0.50f) / PROF_TICKS_PER_US,
+             (double)s->percentile(0.99f) / PROF_TICKS_PER_US,
+             (double)s->max_ticks / PROF_TICKS_PER_US);
+    Serial.println(line);
+  }
+}
+
+void profiler_reset()
+{
+  for (ProfStage *s = __atomic_load_n(&ProfStage::first, __ATOMIC_ACQUIRE); s; s = s->next)
+    s->reset();
+}
@@ -0,0 +1,83 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Scoped stage timers with log-bucketed histograms
+// ----------------------------------------------------------------------------
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdint.h>
+#include "hal.h"
+
+// build with -D PROFILE=0 to compile every PROFILE_SCOPE() away
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+// time base: CPU cycles (CCOUNT) on the ESP32, wall clock ns on the host,
+// where hal_cycles() follows the simulated clock
+#ifdef ARDUINO
+#define PROF_TICKS_PER_US (F_CPU / 1000000)
+inline uint32_t prof_ticks() { return hal_cycles(); }
+#else
+#define PROF_TICKS_PER_US 1000
+uint32_t prof_ticks();
+#endif
+
+// 4 buckets per power of two: bucket width is at most 1/4 of its value
+#define PROF_SUB_BITS  2
+#define PROF_BUCKETS   ((32 << PROF_SUB_BITS) + 1)
+
+// Execution time histogram of one named stage. Stages register themselves
+// in a global list on first use, safely from any task; each stage should
+// be timed from one task only, the counters are not atomic.
+class ProfStage {
+  public:
+    ProfStage(const char *name);
+
+    void record(uint32_t ticks);
+    void reset();
+
+    // tick value below which the given share (0..1) of the samples lie,
+    // accurate to the bucket width
+    uint32_t percentile(float p) const;
+
+    const char *name;
+    uint32_t count;
+    uint32_t max_ticks;
+    uint64_t total_ticks;
+    ProfStage *next;
+
+    static ProfStage *first;
+
+  private:
+    uint32_t _buckets[PROF_BUCKETS];
+};
+
+// times the enclosing scope into a stage
+class ProfScope {
+  public:
+    ProfScope(ProfStage &stage) : _stage(stage), _start(prof_ticks()) {}
+    ~ProfScope() { _stage.record(prof_ticks() - _start); }
+
+  private:
+    ProfStage &_stage;
+    uint32_t _start;
+};
+
+// p50/p99/max in microseconds per stage, one line each, to Serial
+void profiler_dump();
+void profiler_reset();
+
+#define PROF_CONCAT2(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT2(a, b)
+
+#if PROFILE
+#define PROFILE_SCOPE(name) \
+  static ProfStage PROF_CONCAT(_prof_stage_, __LINE__)(name); \
+  ProfScope PROF_CONCAT(_prof_scope_, __LINE__)(PROF_CONCAT(_prof_stage_, __LINE__))
+#else
+#define PROFILE_SCOPE(name) do {} while (0)
+#endif
+
+#endif  // __PROFILER_H__
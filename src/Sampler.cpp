@@ -0,0 +1,130 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Fixed-rate background sampling of the optical motion sensor
+// ----------------------------------------------------------------------------
+
+#include "Sampler.h"
+#include "Profiler.h"
+
+#ifndef ARDUINO
+#include <chrono>
+#endif
+
+Sampler::Sampler(ReadFn read, void *sensor, uint32_t period_us)
+{
+  _read = read;
+  _sensor = sensor;
+  _period_us = period_us;
+  _poll = NULL;
+  _running = false;
+  _paused = false;
+  samples = 0;
+  late = 0;
+  max_jitter_us = 0;
+  max_read_us = 0;
+#ifdef ARDUINO
+  _task = NULL;
+#endif
+}
+
+void Sampler::sampleOnce()
+{
+  MotionSample s;
+  uint32_t t0 = hal_micros();
+  {
+    PROFILE_SCOPE("sensor read");
+    if (!_read(_sensor, s)) return;
+  }
+
+  uint32_t dt = hal_micros() - t0;
+  if (dt > max_read_us) max_read_us = dt;
+  _ring.push(s);
+  samples = samples + 1;
+
+  if (_poll) _period_us = _poll->update(s.dx, s.dy);
+}
+
+void Sampler::account(uint32_t t_us, uint32_t due_us)
+{
+  uint32_t jitter = t_us - due_us;
+  if ((int32_t)jitter < 0) return;
+  if (jitter > max_jitter_us) max_jitter_us = jitter;
+  if (jitter > _period_us) late = late + 1;
+}
+
+#ifdef ARDUINO
+
+bool Sampler::start(int core, int priority)
+{
+  if (_running) return true;
+  _running = true;
+  if (xTaskCreatePinnedToCore(task, "sampler", 2048, this, priority, &_task, core) != pdPASS) {
+    _running = false;
+    return false;
+  }
+  return true;
+}
+
+void Sampler::stop()
+{
+  // the task deletes itself at the end of its current period
+  _running = false;
+}
+
+void Sampler::task(void *self)
+{
+  static_cast<Sampler *>(self)->run();
+  vTaskDelete(NULL);
+}
+
+void Sampler::run()
+{
+  TickType_t wake = xTaskGetTickCount();
+  uint32_t due = hal_micros();
+
+  while (_running) {
+    account(hal_micros(), due);
+    if (!_paused) sampleOnce();
+    TickType_t period = pdMS_TO_TICKS(_period_us / 1000);
+    if (period == 0) period = 1;
+    vTaskDelayUntil(&wake, period);
+    due += period * portTICK_PERIOD_MS * 1000;
+  }
+  _task = NULL;
+}
+
+#else
+
+bool Sampler::start(int /* core */, int /* priority */)
+{
+  if (_running) return true;
+  _running = true;
+  _thread = std::thread(&Sampler::run, this);
+  return true;
+}
+
+void Sampler::stop()
+{
+  _running = false;
+  if (_thread.joinable()) _thread.join();
+}
+
+// paced on the wall clock; timestamps come from hal_micros(), i.e. the
+// simulated clock when a simulated sensor is attached
+void Sampler::run()
+{
+  using namespace std::chrono;
+  steady_clock::time_point start = steady_clock::now();
+  steady_clock::time_point wake = start;
+
+  while (_running) {
+    uint32_t due = duration_cast<microseconds>(wake - start).count();
+    account(duration_cast<microseconds>(steady_clock::now() - start).count(), due);
+    if (!_paused) sampleOnce();
+    uint32_t period = _period_us;
+    wake += microseconds(period);
+    if (period) std::this_thread::sleep_until(wake);
+  }
+}
+
+#endif
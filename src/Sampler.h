@@ -0,0 +1,75 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Fixed-rate background sampling of the optical motion sensor
+// ----------------------------------------------------------------------------
+
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include "hal.h"
+#include "SpscRing.h"
+#include "FlowSensor.h"
+#include "AdaptivePoll.h"
+
+#ifndef ARDUINO
+#include <thread>
+#endif
+
+#define SAMPLER_RING_SIZE 64
+
+// Reads the sensor at a fixed period on its own task (pinned to a core on
+// the ESP32, a std::thread on the host) and pushes the samples into a
+// lock-free ring, which the main loop drains in batches. The sensor must
+// not be touched by anyone else while the sampler runs.
+class Sampler {
+  public:
+    // read_sensor<S> for any FlowSensor
+    typedef bool (*ReadFn)(void *sensor, MotionSample &s);
+
+    Sampler(ReadFn read, void *sensor, uint32_t period_us);
+
+    // let the sample deltas drive the period instead of a fixed rate
+    void setAdaptive(AdaptivePoll *poll) { _poll = poll; }
+    uint32_t period() const { return _period_us; }
+
+    bool start(int core = 0, int priority = 5);
+    void stop();
+    bool running() const { return _running; }
+
+    // keep the task but leave the sensor alone, from the next period on
+    // (the sensor may be powered down or read by someone else meanwhile)
+    void pause(bool paused) { _paused = paused; }
+
+    // consumer side (main loop)
+    uint32_t drain(MotionSample *out, uint32_t max) { return _ring.pop(out, max); }
+
+    // statistics, written by the sampler task only
+    volatile uint32_t samples;
+    volatile uint32_t late;         // periods that started too late
+    volatile uint32_t max_jitter_us;
+    volatile uint32_t max_read_us;  // longest sensor transaction
+    uint32_t dropped() const { return _ring.dropped(); }
+
+    // take and push one sample now
+    void sampleOnce();
+
+  private:
+    ReadFn _read;
+    void *_sensor;
+    volatile uint32_t _period_us;
+    AdaptivePoll *_poll;
+    volatile bool _running;
+    volatile bool _paused;
+    SpscRing<MotionSample, SAMPLER_RING_SIZE> _ring;
+
+#ifdef ARDUINO
+    TaskHandle_t _task;
+    static void task(void *self);
+#else
+    std::thread _thread;
+#endif
+    void run();
+    void account(uint32_t t_us, uint32_t due_us);
+};
+
+#endif  // __SAMPLER_H__
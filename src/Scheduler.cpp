@@ -0,0 +1,156 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Earliest-deadline-first cooperative task scheduler
+// ----------------------------------------------------------------------------
+
+#include "Scheduler.h"
+#include "hal.h"
+
+// wrap-safe time comparison
+static inline bool before(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;
+}
+
+// the one to run first of two ready tasks: earlier deadline, then higher
+// priority; tasks without a deadline after all that have one, among
+// themselves by priority and release
+static bool urgent(const Scheduler::Task &a, const Scheduler::Task &b)
+{
+  if (!a.deadline_us != !b.deadline_us) return a.deadline_us != 0;
+  if (a.deadline_us && a.due_us != b.due_us) return before(a.due_us, b.due_us);
+  if (a.priority != b.priority) return a.priority > b.priority;
+  return before(a.release_us, b.release_us);
+}
+
+Scheduler::Scheduler()
+{
+  _count = 0;
+}
+
+int Scheduler::add(const char *name, TaskFn fn, void *ctx, uint32_t period_us,
+                   uint32_t deadline_us, uint8_t priority)
+{
+  if (_count == SCHED_MAX_TASKS) return -1;
+  Task &t = _tasks[_count];
+  t.name = name;
+  t.fn = fn;
+  t.ctx = ctx;
+  t.period_us = period_us;
+  t.deadline_us = deadline_us ? deadline_us : period_us;
+  t.priority = priority;
+  t.release_us = hal_micros();
+  t.due_us = t.release_us + t.deadline_us;
+  t.ready = period_us != 0;
+  t.signaled = false;
+  resetTask(t);
+  return _count++;
+}
+
+void Scheduler::setPeriod(int id, uint32_t period_us)
+{
+  Task &t = _tasks[id];
+  uint32_t old_period = t.period_us;
+  if (t.deadline_us == t.period_us) t.deadline_us = period_us;
+  t.period_us = period_us;
+  if (!period_us || t.ready) return;
+
+  // an event task (or one that was off) last released who knows when,
+  // maybe more than half the clock ago: start over from now
+  uint32_t now = hal_micros();
+  if (old_period == 0 || before(t.release_us, now))
+    t.release_us = now;
+  else if (before(now + period_us, t.release_us))
+    t.release_us = now + period_us;
+}
+
+void Scheduler::resetTask(Task &t)
+{
+  t.runs = 0;
+  t.missed = 0;
+  t.skipped = 0;
+  t.max_jitter_us = 0;
+  t.max_exec_us = 0;
+  t.last_exec_us = 0;
+  t.total_exec_us = 0;
+}
+
+void Scheduler::resetStats()
+{
+  for (int i = 0; i < _count; ++i) resetTask(_tasks[i]);
+}
+
+// make tasks whose release time has come (or that were signaled) ready
+void Scheduler::release(uint32_t now)
+{
+  for (int i = 0; i < _count; ++i) {
+    Task &t = _tasks[i];
+    if (t.signaled) {
+      t.signaled = false;
+      if (!t.ready) {
+        t.ready = true;
+        t.release_us = now;
+        t.due_us = now + t.deadline_us;
+      }
+    }
+    if (t.period_us && !t.ready && !before(now, t.release_us)) {
+      t.ready = true;
+      t.due_us = t.release_us + t.deadline_us;
+    }
+  }
+}
+
+bool Scheduler::runOnce()
+{
+  uint32_t now = hal_micros();
+  release(now);
+
+  Task *next = 0;
+  for (int i = 0; i < _count; ++i) {
+    Task &t = _tasks[i];
+    if (!t.ready || before(now, t.release_us)) continue;
+    if (!next || urgent(t, *next)) next = &t;
+  }
+  if (!next) return false;
+
+  Task &t = *next;
+  uint32_t jitter = now - t.release_us;
+  if (jitter > t.max_jitter_us) t.max_jitter_us = jitter;
+
+  t.ready = false;
+  t.fn(t.ctx);
+  uint32_t end = hal_micros();
+
+  uint32_t exec = end - now;
+  t.last_exec_us = exec;
+  t.total_exec_us += exec;
+  if (exec > t.max_exec_us) t.max_exec_us = exec;
+  if (t.deadline_us && before(t.due_us, end)) ++t.missed;
+  ++t.runs;
+
+  // next release on the period grid; releases that already passed while
+  // this one waited or ran are dropped, not queued
+  if (t.period_us) {
+    t.release_us += t.period_us;
+    if (!before(end, t.release_us + t.period_us)) {
+      uint32_t late = (end - t.release_us) / t.period_us;
+      t.release_us += late * t.period_us;
+      t.skipped += late;
+    }
+  }
+  return true;
+}
+
+uint32_t Scheduler::idle() const
+{
+  uint32_t now = hal_micros();
+  uint32_t wait = UINT32_MAX;
+  for (int i = 0; i < _count; ++i) {
+    const Task &t = _tasks[i];
+    if (t.ready || t.signaled) return 0;
+    if (!t.period_us) continue;
+    uint32_t d = before(now, t.release_us) ? t.release_us - now : 0;
+    if (d < wait) wait = d;
+  }
+  return wait;
+}
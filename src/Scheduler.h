@@ -0,0 +1,80 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Earliest-deadline-first cooperative task scheduler
+// ----------------------------------------------------------------------------
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS 8
+
+// Runs short task functions from loop(). A periodic task is released every
+// period_us; an event task (period 0) only when signal()ed, which is safe
+// from an ISR. Every release gets an absolute deadline (release +
+// deadline_us, the period by default), and runOnce() runs the ready task
+// with the earliest deadline, the higher priority on a tie. An event task
+// without a deadline (0) is never late and runs when no task with a
+// deadline is ready. Tasks are not preempted. Time comes from
+// hal_micros(), so on the host the scheduler runs on the simulated clock
+// and is deterministic.
+class Scheduler {
+  public:
+    typedef void (*TaskFn)(void *ctx);
+
+    struct Task {
+      const char *name;
+      TaskFn fn;
+      void *ctx;
+      uint32_t period_us;     // 0: event driven
+      uint32_t deadline_us;   // relative to the release, 0: none
+      uint8_t priority;       // tie breaker, higher first
+
+      uint32_t release_us;    // current (or next) release
+      uint32_t due_us;        // absolute deadline of the current release
+      bool ready;
+      volatile bool signaled;
+
+      // statistics
+      uint32_t runs;
+      uint32_t missed;        // finished after the deadline
+      uint32_t skipped;       // releases lost while still pending
+      uint32_t max_jitter_us; // start - release
+      uint32_t max_exec_us;
+      uint32_t last_exec_us;
+      uint64_t total_exec_us;
+    };
+
+    Scheduler();
+
+    int add(const char *name, TaskFn fn, void *ctx, uint32_t period_us,
+            uint32_t deadline_us = 0, uint8_t priority = 0);
+
+    // release an event task now; a periodic task runs now and keeps its
+    // period from there
+    void signal(int id) { _tasks[id].signaled = true; }
+
+    // change the period (0: event task from now on); the deadline follows
+    // if it was the period. A shorter period applies to the pending release,
+    // a task that had no period (or is late) is released right away.
+    void setPeriod(int id, uint32_t period_us);
+
+    // run the most urgent ready task, false if none was ready
+    bool runOnce();
+    // time until the next periodic release
+    uint32_t idle() const;
+
+    int count() const { return _count; }
+    const Task &task(int id) const { return _tasks[id]; }
+    void resetStats();
+
+  private:
+    Task _tasks[SCHED_MAX_TASKS];
+    int _count;
+
+    void release(uint32_t now);
+    void resetTask(Task &t);
+};
+
+#endif  // __SCHEDULER_H__
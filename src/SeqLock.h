@@ -0,0 +1,70 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Sequence lock: one writer, any number of readers that never block it
+// ----------------------------------------------------------------------------
+
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// The writer makes the sequence odd, copies the value in and makes it even
+// again. A reader copies the value out between two loads of the sequence
+// and retries if it was odd or changed meanwhile. The value is kept in
+// atomic words, so a torn copy is thrown away rather than undefined.
+// For plain structs (memcpy-able), padded to whole words.
+template <typename T>
+class SeqLock {
+  public:
+    enum { WORDS = (sizeof(T) + 3) / 4 };
+
+    SeqLock() : _seq(0), _retries(0) {
+      for (int i = 0; i < WORDS; ++i) _data[i].store(0, std::memory_order_relaxed);
+    }
+
+    // writer side, one task only
+    void write(const T &value) {
+      uint32_t words[WORDS] = { 0 };
+      memcpy(words, &value, sizeof(T));
+      uint32_t seq = _seq.load(std::memory_order_relaxed);
+      _seq.store(seq + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (int i = 0; i < WORDS; ++i) _data[i].store(words[i], std::memory_order_relaxed);
+      _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // any task: false if the writer kept getting in the way (or nothing was
+    // written yet), out is left alone then
+    bool read(T &out, int tries = 8) const {
+      uint32_t words[WORDS];
+      while (tries-- > 0) {
+        uint32_t seq = _seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+          _retries.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        for (int i = 0; i < WORDS; ++i) words[i] = _data[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_seq.load(std::memory_order_relaxed) != seq) {
+          _retries.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        if (seq == 0) return false;
+        memcpy(&out, words, sizeof(T));
+        return true;
+      }
+      return false;
+    }
+
+    uint32_t writes() const { return _seq.load(std::memory_order_relaxed) / 2; }
+    uint32_t retries() const { return _retries.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint32_t> _seq;
+    std::atomic<uint32_t> _data[WORDS];
+    mutable std::atomic<uint32_t> _retries;
+};
+
+#endif  // __SEQLOCK_H__
@@ -0,0 +1,122 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Shared SPI bus for devices on different pin sets
+// ----------------------------------------------------------------------------
+
+#ifdef ARDUINO
+
+#include "SpiBus.h"
+#include <esp32-hal-spi.h>
+
+SpiBus::SpiBus(SPIClass &spi) : _spi(spi)
+{
+  _count = 0;
+  _selected = SPI_NONE;
+  _started = false;
+  _acquired_us = 0;
+  resetStats();
+}
+
+int SpiBus::add(const char *name, int8_t sck, int8_t miso, int8_t mosi, int8_t cs,
+                const SPISettings &settings, CheckFn check, InitFn init, void *device)
+{
+  if (_count == SPI_BUS_MAX_DEVICES) return SPI_NONE;
+  Device &d = _devices[_count];
+  d.name = name;
+  d.sck = sck;
+  d.miso = miso;
+  d.mosi = mosi;
+  d.cs = cs;
+  d.settings = settings;
+  d.check = check;
+  d.init = init;
+  d.device = device;
+  return _count++;
+}
+
+// move only the signals whose pin differs; chip selects stay outputs
+// and are parked high before the new device sees a clock
+void SpiBus::route(const Device &from, const Device &to)
+{
+  spi_t *spi = _spi.bus();
+
+  if (from.sck != to.sck) spiDetachSCK(spi, from.sck);
+  if (from.miso != to.miso) spiDetachMISO(spi, from.miso);
+  if (from.mosi != to.mosi) spiDetachMOSI(spi, from.mosi);
+
+  if (to.cs >= 0) {
+    digitalWrite(to.cs, HIGH);
+    pinMode(to.cs, OUTPUT);
+  }
+
+  if (from.sck != to.sck) spiAttachSCK(spi, to.sck);
+  if (from.miso != to.miso) spiAttachMISO(spi, to.miso);
+  if (from.mosi != to.mosi) spiAttachMOSI(spi, to.mosi);
+}
+
+void SpiBus::acquire(int dev)
+{
+  if (dev != _selected) {
+    uint32_t t0 = micros();
+    Device &d = _devices[dev];
+
+    if (!_started) {
+      // first use: bring up the peripheral once, on this device's pins
+      pinMode(d.cs, OUTPUT);
+      digitalWrite(d.cs, HIGH);
+      _spi.begin(d.sck, d.miso, d.mosi);
+      _started = true;
+    } else {
+      route(_devices[_selected], d);
+    }
+    _selected = dev;
+
+    // the other device clocked through our pins, make sure we still talk
+    if (d.check && !d.check(d.device)) {
+      if (d.init) d.init(d.device);
+      ++recoveries;
+    }
+
+    last_switch_us = micros() - t0;
+    if (last_switch_us > max_switch_us) max_switch_us = last_switch_us;
+    ++switches;
+  }
+  _acquired_us = micros();
+}
+
+void SpiBus::release()
+{
+  busy_us += micros() - _acquired_us;
+}
+
+void SpiBus::begin(int dev)
+{
+  acquire(dev);
+  _spi.beginTransaction(_devices[dev].settings);
+  digitalWrite(_devices[dev].cs, LOW);
+}
+
+void SpiBus::end()
+{
+  digitalWrite(_devices[_selected].cs, HIGH);
+  _spi.endTransaction();
+  release();
+}
+
+void SpiBus::resetStats()
+{
+  switches = 0;
+  recoveries = 0;
+  last_switch_us = 0;
+  max_switch_us = 0;
+  busy_us = 0;
+  _stats_us = micros();
+}
+
+float SpiBus::utilization() const
+{
+  uint32_t total = micros() - _stats_us;
+  return total ? (float)busy_us / total : 0;
+}
+
+#endif  // ARDUINO
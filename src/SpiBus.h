@@ -0,0 +1,80 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Shared SPI bus for devices on different pin sets
+// ----------------------------------------------------------------------------
+
+#ifndef __SPIBUS_H__
+#define __SPIBUS_H__
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#define SPI_BUS_MAX_DEVICES 4
+#define SPI_NONE -1
+
+// Owns the SPI peripheral. The RFID reader and the LoRa radio are wired to
+// different (partly swapped) pins, so switching devices re-routes the SCK,
+// MISO and MOSI signals through the GPIO matrix instead of SPI.end() and
+// SPI.begin(). A device keeps its state across switches; its check
+// function is called after a switch and its init function only if the
+// check fails. To be used from one task only.
+class SpiBus {
+  public:
+    typedef bool (*CheckFn)(void *device);
+    typedef void (*InitFn)(void *device);
+
+    SpiBus(SPIClass &spi);
+
+    int add(const char *name, int8_t sck, int8_t miso, int8_t mosi, int8_t cs,
+            const SPISettings &settings,
+            CheckFn check = NULL, InitFn init = NULL, void *device = NULL);
+
+    // route the bus to a device and mark it busy until release()
+    void acquire(int dev);
+    void release();
+
+    // transaction with the device settings and its chip select, for
+    // drivers that do not manage them themselves
+    void begin(int dev);
+    void end();
+
+    int selected() const { return _selected; }
+
+    // statistics
+    uint32_t switches;
+    uint32_t recoveries;      // failed checks followed by an init
+    uint32_t last_switch_us;
+    uint32_t max_switch_us;
+    uint32_t busy_us;         // time between acquire() and release()
+    void resetStats();
+    float utilization() const;  // busy share of the time since resetStats()
+
+  private:
+    struct Device {
+      const char *name;
+      int8_t sck;
+      int8_t miso;
+      int8_t mosi;
+      int8_t cs;
+      SPISettings settings;
+      CheckFn check;
+      InitFn init;
+      void *device;
+    };
+
+    SPIClass &_spi;
+    Device _devices[SPI_BUS_MAX_DEVICES];
+    int _count;
+    int _selected;
+    bool _started;
+    uint32_t _acquired_us;
+    uint32_t _stats_us;
+
+    void route(const Device &from, const Device &to);
+};
+
+#endif  // ARDUINO
+
+#endif  // __SPIBUS_H__
@@ -0,0 +1,61 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Lock-free single-producer/single-consumer ring buffer
+// ----------------------------------------------------------------------------
+
+#ifndef __SPSCRING_H__
+#define __SPSCRING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// One task pushes, another pops; no locks, no allocation. N must be a
+// power of two. Head and tail are free-running counters, so the ring can
+// hold all N slots. A push into a full ring is refused and counted.
+template <typename T, uint32_t N>
+class SpscRing {
+  static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+
+  public:
+    SpscRing() : _head(0), _tail(0), _dropped(0) {}
+
+    // producer side
+    bool push(const T &item) {
+      uint32_t head = _head.load(std::memory_order_relaxed);
+      if (head - _tail.load(std::memory_order_acquire) == N) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      _buf[head & (N - 1)] = item;
+      _head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    // consumer side: take up to max items in one go
+    uint32_t pop(T *out, uint32_t max) {
+      uint32_t tail = _tail.load(std::memory_order_relaxed);
+      uint32_t n = _head.load(std::memory_order_acquire) - tail;
+      if (n > max) n = max;
+      for (uint32_t i = 0; i < n; ++i)
+        out[i] = _buf[(tail + i) & (N - 1)];
+      _tail.store(tail + n, std::memory_order_release);
+      return n;
+    }
+
+    bool pop(T &out) { return pop(&out, 1) == 1; }
+
+    uint32_t size() const {
+      return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+    static uint32_t capacity() { return N; }
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+  private:
+    T _buf[N];
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+    std::atomic<uint32_t> _dropped;
+};
+
+#endif  // __SPSCRING_H__
@@ -0,0 +1,89 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Staged, non-blocking startup of the peripherals
+// ----------------------------------------------------------------------------
+
+#include "Startup.h"
+#include "hal.h"
+
+static const char *state_names[] = { "waiting", "running", "ready", "failed" };
+
+const char *startup_state_name(Startup::State state)
+{
+  return state_names[state];
+}
+
+Startup::Startup()
+{
+  _count = 0;
+  _pending = 0;
+  _started = false;
+  _begin_ms = 0;
+}
+
+int Startup::add(const char *name, StepFn fn, void *ctx, int after)
+{
+  if (_count == STARTUP_MAX_UNITS) return -1;
+  Unit &u = _units[_count];
+  u.name = name;
+  u.fn = fn;
+  u.ctx = ctx;
+  u.after = after;
+  u.state = WAITING;
+  u.step = 0;
+  u.due_ms = 0;
+  u.start_ms = u.ready_ms = 0;
+  u.busy_us = 0;
+  ++_pending;
+  return _count++;
+}
+
+void Startup::finish(Unit &u, State state, uint32_t now_ms)
+{
+  u.state = state;
+  u.ready_ms = now_ms;
+  --_pending;
+}
+
+uint32_t Startup::run(uint32_t now_ms)
+{
+  if (!_started) {
+    _started = true;
+    _begin_ms = now_ms;
+  }
+
+  uint32_t wait = UINT32_MAX;
+  for (int i = 0; i < _count; ++i) {
+    Unit &u = _units[i];
+
+    if (u.state == WAITING) {
+      if (u.after >= 0 && _units[u.after].state == FAILED) {
+        finish(u, FAILED, now_ms);
+        continue;
+      }
+      if (u.after >= 0 && _units[u.after].state != READY) continue;
+      u.state = RUNNING;
+      u.start_ms = u.due_ms = now_ms;
+    }
+    if (u.state != RUNNING) continue;
+
+    if ((int32_t)(now_ms - u.due_ms) >= 0) {
+      uint32_t t0 = hal_micros();
+      int32_t result = u.fn(u.ctx, u.step++);
+      u.busy_us += hal_micros() - t0;
+      now_ms = hal_millis();
+      if (result == STARTUP_DONE || result == STARTUP_FAILED) {
+        finish(u, result == STARTUP_DONE ? READY : FAILED, now_ms);
+        i = -1;                 // units waiting for this one may start
+        continue;
+      }
+      u.due_ms = now_ms + result;
+    }
+    uint32_t d = u.due_ms - now_ms;
+    if ((int32_t)d < 0) d = 0;
+    if (d < wait) wait = d;
+  }
+
+  if (_pending == 0) return 0;
+  return wait == 0 || wait == UINT32_MAX ? 1 : wait;
+}
@@ -0,0 +1,68 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Staged, non-blocking startup of the peripherals
+// ----------------------------------------------------------------------------
+
+#ifndef __STARTUP_H__
+#define __STARTUP_H__
+
+#include <stdint.h>
+
+#define STARTUP_MAX_UNITS 8
+#define STARTUP_DONE    -1      // step results besides a wait in ms
+#define STARTUP_FAILED  -2
+
+// Brings up independent peripherals side by side instead of one delay()
+// after the other. Each unit is a step function: step n does its part and
+// returns the ms to wait before step n+1, or STARTUP_DONE/STARTUP_FAILED.
+// A unit can wait for another one (after); it fails if that one failed.
+// run() does the steps that are due and tells how long nothing is due,
+// so it fits a scheduler task or loop() without blocking either.
+class Startup {
+  public:
+    typedef int32_t (*StepFn)(void *ctx, uint16_t step);
+
+    enum State { WAITING, RUNNING, READY, FAILED };
+
+    struct Unit {
+      const char *name;
+      StepFn fn;
+      void *ctx;
+      int after;
+      State state;
+      uint16_t step;
+      uint32_t due_ms;
+
+      // statistics
+      uint32_t start_ms;
+      uint32_t ready_ms;        // or failed
+      uint32_t busy_us;         // time spent in the steps
+    };
+
+    Startup();
+
+    int add(const char *name, StepFn fn, void *ctx, int after = -1);
+
+    // run the due steps, returns the ms until the next one is due
+    // (at least 1), 0 when all units are finished
+    uint32_t run(uint32_t now_ms);
+
+    bool ready(int id) const { return id >= 0 && _units[id].state == READY; }
+    bool finished() const { return _pending == 0; }
+    int count() const { return _count; }
+    const Unit &unit(int id) const { return _units[id]; }
+    uint32_t begin_ms() const { return _begin_ms; }
+
+  private:
+    Unit _units[STARTUP_MAX_UNITS];
+    int _count;
+    int _pending;
+    bool _started;
+    uint32_t _begin_ms;
+
+    void finish(Unit &u, State state, uint32_t now_ms);
+};
+
+const char *startup_state_name(Startup::State state);
+
+#endif  // __STARTUP_H__
@@ -0,0 +1,172 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// OLED status screen with per-field redraw and differential flush
+// ----------------------------------------------------------------------------
+
+#ifdef ARDUINO
+
+#include "StatusScreen.h"
+
+DiffSSD1306::DiffSSD1306(uint8_t address, uint8_t sda, uint8_t scl,
+                         TwoWire *wire, uint32_t frequency)
+{
+  setGeometry(GEOMETRY_128_64);
+  _wire = wire;
+  _address = address;
+  _sda = sda;
+  _scl = scl;
+  _frequency = frequency;
+  _invalid = true;
+  flushes = 0;
+  bytes_sent = 0;
+  last_flush_us = 0;
+}
+
+bool DiffSSD1306::connect()
+{
+  _wire->begin(_sda, _scl);
+  _wire->setClock(_frequency);
+  return true;
+}
+
+void DiffSSD1306::display()
+{
+  _invalid = true;
+  displayDiff();
+}
+
+void DiffSSD1306::sendCommand(uint8_t command)
+{
+  _wire->beginTransmission(_address);
+  _wire->write(0x80);
+  _wire->write(command);
+  _wire->endTransmission();
+}
+
+void DiffSSD1306::sendSpan(int page, const PageSpan &span)
+{
+  sendCommand(COLUMNADDR);
+  sendCommand(span.first);
+  sendCommand(span.last);
+  sendCommand(PAGEADDR);
+  sendCommand(page);
+  sendCommand(page);
+
+  const uint8_t *p = buffer + page * OLED_WIDTH + span.first;
+  int n = span.length();
+  while (n > 0) {
+    int k = n > OLED_I2C_CHUNK ? OLED_I2C_CHUNK : n;
+    _wire->beginTransmission(_address);
+    _wire->write(0x40);
+    _wire->write(p, k);
+    _wire->endTransmission();
+    p += k;
+    n -= k;
+  }
+}
+
+void DiffSSD1306::displayDiff()
+{
+  uint32_t t0 = micros();
+  PageSpan spans[OLED_PAGES];
+  int bytes;
+
+  if (_invalid) {
+    for (int page = 0; page < OLED_PAGES; ++page) {
+      spans[page].first = 0;
+      spans[page].last = OLED_WIDTH - 1;
+    }
+    memcpy(_shown, buffer, OLED_BUFFER_SIZE);
+    bytes = OLED_BUFFER_SIZE;
+    _invalid = false;
+  } else {
+    bytes = frame_diff(buffer, _shown, spans);
+  }
+
+  for (int page = 0; page < OLED_PAGES; ++page)
+    if (!spans[page].empty())
+      sendSpan(page, spans[page]);
+
+  ++flushes;
+  bytes_sent += bytes;
+  last_flush_us = micros() - t0;
+}
+
+
+// layout of the former info() screen; rows overlap the 13 px font height,
+// so each field clears only the rows down to the next line
+StatusScreen::StatusScreen(DiffSSD1306 &display) : _display(display)
+{
+  static const int16_t layout[NUM_FIELDS][4] = {
+    {  0,  0,  43, 12 },   // VEHICLE
+    { 43,  0,  85, 12 },   // IP
+    { 20, 43,  70, 10 },   // LOCATION
+    { 90, 43,  38, 10 },   // DISTANCE
+    { 20, 53, 108, 11 },   // DESTINATION
+  };
+
+  for (int i = 0; i < NUM_FIELDS; ++i) {
+    _slots[i].x = layout[i][0];
+    _slots[i].y = layout[i][1];
+    _slots[i].w = layout[i][2];
+    _slots[i].h = layout[i][3];
+    _slots[i].value[0] = 0;
+    _slots[i].dirty = true;
+  }
+  _labels = false;
+  fields_drawn = 0;
+}
+
+void StatusScreen::set(Field field, const char *value)
+{
+  Slot &s = _slots[field];
+  if (strncmp(s.value, value, sizeof(s.value) - 1) == 0) return;
+  strncpy(s.value, value, sizeof(s.value) - 1);
+  s.value[sizeof(s.value) - 1] = 0;
+  s.dirty = true;
+}
+
+void StatusScreen::set(Field field, long value)
+{
+  char buf[12];
+  set(field, ltoa(value, buf, 10));
+}
+
+void StatusScreen::render()
+{
+  _display.setFont(ArialMT_Plain_10);
+  _display.setTextAlignment(TEXT_ALIGN_LEFT);
+
+  if (!_labels) {
+    _display.clear();
+    _display.setColor(WHITE);
+    _display.drawString(0, 43, "@");
+    _display.drawString(0, 53, ">>");
+    _labels = true;
+  }
+
+  for (int i = 0; i < NUM_FIELDS; ++i) {
+    Slot &s = _slots[i];
+    if (!s.dirty) continue;
+    _display.setColor(BLACK);
+    _display.fillRect(s.x, s.y, s.w, s.h);
+    _display.setColor(WHITE);
+    _display.drawString(s.x, s.y, s.value);
+    s.dirty = false;
+    ++fields_drawn;
+  }
+
+  _display.displayDiff();
+}
+
+void StatusScreen::show(const StatusSnapshot &s)
+{
+  set(VEHICLE, s.vehicle);
+  set(IP, s.ip);
+  set(LOCATION, s.location);
+  set(DISTANCE, s.distance_mm);
+  set(DESTINATION, s.destination);
+  render();
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,94 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// OLED status screen with per-field redraw and differential flush
+// ----------------------------------------------------------------------------
+
+#ifndef __STATUSSCREEN_H__
+#define __STATUSSCREEN_H__
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <OLEDDisplay.h>
+#include "FrameDiff.h"
+#include "DisplayService.h"
+
+// bytes per I2C data transaction (the ESP32 Wire buffer holds 128)
+#define OLED_I2C_CHUNK 64
+
+// SSD1306 on I2C that keeps a copy of what the panel shows and only sends
+// the changed column span of each page instead of the whole 1 KB
+// framebuffer. Built on OLEDDisplay rather than SSD1306Wire, whose
+// command and bus members are private.
+class DiffSSD1306 : public OLEDDisplay {
+  public:
+    DiffSSD1306(uint8_t address, uint8_t sda, uint8_t scl,
+                TwoWire *wire = &Wire, uint32_t frequency = 700000);
+
+    bool connect();
+    void display();                          // the whole framebuffer
+    void displayDiff();
+    void invalidate() { _invalid = true; }   // next displayDiff() sends everything
+
+    // statistics
+    uint32_t flushes;
+    uint32_t bytes_sent;
+    uint32_t last_flush_us;
+
+  protected:
+    void sendCommand(uint8_t command);
+    int getBufferOffset() { return 0; }
+
+  private:
+    TwoWire *_wire;
+    uint8_t _address;
+    uint8_t _sda;
+    uint8_t _scl;
+    uint32_t _frequency;
+    bool _invalid;
+    uint8_t _shown[OLED_BUFFER_SIZE];
+
+    void sendSpan(int page, const PageSpan &span);
+};
+
+// The status screen as a set of text fields. A field is only cleared and
+// redrawn when its value changed, and the flush only sends what differs.
+class StatusScreen {
+  public:
+    enum Field { VEHICLE, IP, LOCATION, DISTANCE, DESTINATION, NUM_FIELDS };
+
+    StatusScreen(DiffSSD1306 &display);
+
+    void set(Field field, const char *value);
+    void set(Field field, long value);
+    void render();
+    void show(const StatusSnapshot &s);   // set all fields and render
+
+    // statistics
+    uint32_t fields_drawn;
+
+  private:
+    struct Slot {
+      int16_t x;
+      int16_t y;
+      int16_t w;
+      int16_t h;
+      char value[24];
+      bool dirty;
+    };
+
+    DiffSSD1306 &_display;
+    Slot _slots[NUM_FIELDS];
+    bool _labels;
+};
+
+// render function for the DisplayService
+inline void render_status_screen(void *screen, const StatusSnapshot &s)
+{
+  static_cast<StatusScreen *>(screen)->show(s);
+}
+
+#endif  // ARDUINO
+
+#endif  // __STATUSSCREEN_H__
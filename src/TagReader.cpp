@@ -0,0 +1,140 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Short RFID read path for a single location tag in the field
+// ----------------------------------------------------------------------------
+
+#ifdef ARDUINO
+
+#include "TagReader.h"
+
+#define CASCADE_TAG 0x88
+#define NVB_ANTICOLL 0x20   // 2 bytes sent, ask for the rest
+#define NVB_SELECT   0x70   // 7 bytes sent: full UID part and BCC
+
+static const byte sel_cmd[] = {
+  MFRC522::PICC_CMD_SEL_CL1, MFRC522::PICC_CMD_SEL_CL2, MFRC522::PICC_CMD_SEL_CL3
+};
+
+TagReader::TagReader(MFRC522 &reader) : _reader(reader)
+{
+  _uid.size = 0;
+  _cached = false;
+  _selected = false;
+  reads = 0;
+  fast_reads = 0;
+  fallbacks = 0;
+  same = 0;
+  left = 0;
+}
+
+// ANTICOLLISION for one cascade level, returns four UID bytes (or the
+// cascade tag and three) with the BCC checked
+bool TagReader::anticollision(byte level, byte *four)
+{
+  byte cmd[2] = { sel_cmd[level], NVB_ANTICOLL };
+  byte back[5];
+  byte len = sizeof(back);
+  byte bits = 0;
+
+  _reader.PCD_ClearRegisterBitMask(MFRC522::CollReg, 0x80);
+  if (_reader.PCD_TransceiveData(cmd, 2, back, &len, &bits) != MFRC522::STATUS_OK) return false;
+  if (len != 5 || (back[0] ^ back[1] ^ back[2] ^ back[3]) != back[4]) return false;
+  memcpy(four, back, 4);
+  return true;
+}
+
+// SELECT for one cascade level
+bool TagReader::select(byte level, const byte *four, byte &sak)
+{
+  byte cmd[9] = { sel_cmd[level], NVB_SELECT, four[0], four[1], four[2], four[3] };
+  cmd[6] = four[0] ^ four[1] ^ four[2] ^ four[3];
+  if (_reader.PCD_CalculateCRC(cmd, 7, cmd + 7) != MFRC522::STATUS_OK) return false;
+
+  byte back[3];
+  byte len = sizeof(back);
+  if (_reader.PCD_TransceiveData(cmd, 9, back, &len, NULL, 0, true) != MFRC522::STATUS_OK) return false;
+  sak = back[0];
+  return true;
+}
+
+// select the cached UID through all of its cascade levels
+bool TagReader::selectCached()
+{
+  byte levels = _uid.size == 4 ? 1 : (_uid.size == 7 ? 2 : 3);
+  const byte *p = _uid.uidByte;
+  byte four[4];
+  byte sak = 0;
+
+  for (byte level = 0; level < levels; ++level) {
+    if (level + 1 < levels) {
+      four[0] = CASCADE_TAG;
+      memcpy(four + 1, p, 3);
+      p += 3;
+    } else {
+      memcpy(four, p, 4);
+    }
+    if (!select(level, four, sak)) return false;
+  }
+  _uid.sak = sak;
+  return true;
+}
+
+TagReader::Result TagReader::read()
+{
+  ++reads;
+  _selected = false;
+
+  MFRC522::Uid last = _uid;
+  bool had = _cached;
+  byte four[4];
+  if (anticollision(0, four) && four[0] != CASCADE_TAG) {
+    memcpy(_uid.uidByte, four, 4);
+    _uid.size = 4;
+    ++fast_reads;
+  } else {
+    // 7 and 10 byte UIDs, collisions: full cascade by the library; the
+    // tag is still ready after a failed or partial anticollision
+    ++fallbacks;
+    if (_reader.PICC_Select(&_uid) != MFRC522::STATUS_OK) {
+      _cached = false;
+      return NONE;
+    }
+    _selected = true;
+  }
+  _cached = true;
+
+  // the tag we just read lost power for a moment and woke up again
+  if (had && last.size == _uid.size && memcmp(last.uidByte, _uid.uidByte, _uid.size) == 0) {
+    ++same;
+    return SAME;
+  }
+  return NEW;
+}
+
+void TagReader::halt()
+{
+  if (!_selected) {
+    byte sak;
+    if (!select(0, _uid.uidByte, sak)) return;
+    _uid.sak = sak;
+  }
+  _reader.PICC_HaltA();
+  _selected = false;
+}
+
+bool TagReader::present()
+{
+  if (!_cached) return false;
+
+  byte atqa[2];
+  byte len = sizeof(atqa);
+  if (_reader.PICC_WakeupA(atqa, &len) == MFRC522::STATUS_OK && selectCached()) {
+    _reader.PICC_HaltA();
+    return true;
+  }
+  _cached = false;
+  ++left;
+  return false;
+}
+
+#endif  // ARDUINO
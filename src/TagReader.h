@@ -0,0 +1,54 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Short RFID read path for a single location tag in the field
+// ----------------------------------------------------------------------------
+
+#ifndef __TAGREADER_H__
+#define __TAGREADER_H__
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <MFRC522.h>
+
+// Reads the UID of the one tag that answered a REQA with the shortest
+// frame sequence: a 4-byte UID is known after a single anticollision
+// frame, the SELECT and HLTA follow in halt(), after the location has
+// been updated. The last UID is cached, so a tag that answers again
+// without having left is reported as SAME, and present() checks with a
+// WUPA and a SELECT on the cached UID whether the halted tag is still in
+// the field. Longer UIDs and collisions fall back to PICC_Select().
+class TagReader {
+  public:
+    enum Result { NONE, SAME, NEW };
+
+    TagReader(MFRC522 &reader);
+
+    Result read();          // after an ATQA, see CardWatch
+    void halt();            // select (if needed) and halt the tag
+    bool present();         // false once the cached tag left the field
+
+    bool cached() const { return _cached; }
+    const MFRC522::Uid &uid() const { return _uid; }
+
+    // statistics
+    uint32_t reads;
+    uint32_t fast_reads;    // UID after one anticollision frame
+    uint32_t fallbacks;     // full library cascade
+    uint32_t same;          // cached tag answered again
+    uint32_t left;          // cached tag gone
+
+  private:
+    MFRC522 &_reader;
+    MFRC522::Uid _uid;
+    bool _cached;
+    bool _selected;
+
+    bool anticollision(byte level, byte *four);
+    bool select(byte level, const byte *four, byte &sak);
+    bool selectCached();
+};
+
+#endif  // ARDUINO
+
+#endif  // __TAGREADER_H__
@@ -0,0 +1,271 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Location tag table with hashed lookup by full UID
+// ----------------------------------------------------------------------------
+
+#include "TagRegistry.h"
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef ARDUINO
+#include <SPIFFS.h>
+#else
+#include <stdio.h>
+#endif
+
+#define TAG_LINE_LEN 160
+
+TagRegistry::TagRegistry(TagRecord *records, uint16_t capacity,
+                         uint16_t *uid_slots, uint16_t *name_slots, uint32_t slot_count)
+{
+  _records = records;
+  _capacity = capacity < TAG_NONE ? capacity : TAG_NONE - 1;
+  _uid_slots = uid_slots;
+  _name_slots = name_slots;
+  _mask = slot_count - 1;
+  clear();
+}
+
+void TagRegistry::clear()
+{
+  _count = 0;
+  for (uint32_t i = 0; i <= _mask; ++i) {
+    _uid_slots[i] = TAG_NONE;
+    _name_slots[i] = TAG_NONE;
+  }
+}
+
+// FNV-1a; UIDs are mostly random already, but 7 and 10 byte UIDs start
+// with a manufacturer byte and many names share a prefix
+uint32_t TagRegistry::hashUid(const uint8_t *uid, uint8_t size)
+{
+  uint32_t h = 2166136261u ^ size;
+  for (uint8_t i = 0; i < size; ++i)
+    h = (h ^ uid[i]) * 16777619u;
+  return h;
+}
+
+uint32_t TagRegistry::hashName(const char *name)
+{
+  uint32_t h = 2166136261u;
+  while (*name)
+    h = (h ^ (uint8_t)*name++) * 16777619u;
+  return h;
+}
+
+int TagRegistry::formatUid(const uint8_t *uid, uint8_t size, char *out, int len)
+{
+  static const char hex[] = "0123456789abcdef";
+  int n = 0;
+  for (uint8_t i = 0; i < size && n + 2 < len; ++i) {
+    out[n++] = hex[uid[i] >> 4];
+    out[n++] = hex[uid[i] & 0x0f];
+  }
+  out[n] = 0;
+  return n;
+}
+
+// slot holding the UID, or the empty slot where it would go
+uint32_t TagRegistry::probeUid(const uint8_t *uid, uint8_t size) const
+{
+  uint32_t i = hashUid(uid, size) & _mask;
+  for (;;) {
+    uint16_t r = _uid_slots[i];
+    if (r == TAG_NONE) return i;
+    const TagRecord &t = _records[r];
+    if (t.uid_size == size && memcmp(t.uid, uid, size) == 0) return i;
+    i = (i + 1) & _mask;
+  }
+}
+
+uint32_t TagRegistry::probeName(const char *name) const
+{
+  uint32_t i = hashName(name) & _mask;
+  for (;;) {
+    uint16_t r = _name_slots[i];
+    if (r == TAG_NONE || strcmp(_records[r].name, name) == 0) return i;
+    i = (i + 1) & _mask;
+  }
+}
+
+const TagRecord *TagRegistry::find(const uint8_t *uid, uint8_t size) const
+{
+  uint16_t r = _uid_slots[probeUid(uid, size)];
+  return r == TAG_NONE ? NULL : &_records[r];
+}
+
+const TagRecord *TagRegistry::findName(const char *name) const
+{
+  uint16_t r = _name_slots[probeName(name)];
+  return r == TAG_NONE ? NULL : &_records[r];
+}
+
+uint32_t TagRegistry::maxProbe() const
+{
+  uint32_t worst = 0;
+  for (uint16_t r = 0; r < _count; ++r) {
+    uint32_t home = hashUid(_records[r].uid, _records[r].uid_size) & _mask;
+    uint32_t at = probeUid(_records[r].uid, _records[r].uid_size);
+    uint32_t run = ((at - home) & _mask) + 1;
+    if (run > worst) worst = run;
+  }
+  return worst;
+}
+
+
+// whitespace separated token in a line: start, length in n, 0 at the end
+static const char *next_token(const char *&p, int &n)
+{
+  while (*p == ' ' || *p == '\t') ++p;
+  const char *start = p;
+  while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') ++p;
+  n = p - start;
+  return n ? start : NULL;
+}
+
+static int hex_digit(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool parse_uid(const char *s, int n, uint8_t *uid, uint8_t &size)
+{
+  if (n != 8 && n != 14 && n != 20) return false;
+  for (int i = 0; i < n; i += 2) {
+    int hi = hex_digit(s[i]), lo = hex_digit(s[i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    uid[i / 2] = (hi << 4) | lo;
+  }
+  size = n / 2;
+  return true;
+}
+
+static bool copy_name(const char *s, int n, char *name)
+{
+  if (n >= TAG_NAME_LEN) return false;
+  memcpy(name, s, n);
+  name[n] = 0;
+  return true;
+}
+
+static bool skip_line(const char *line)
+{
+  while (*line == ' ' || *line == '\t') ++line;
+  return *line == '#' || *line == 0 || *line == '\n' || *line == '\r';
+}
+
+bool TagRegistry::addLine(const char *line)
+{
+  if (skip_line(line)) return false;
+  if (_count == _capacity) return false;
+
+  TagRecord &t = _records[_count];
+  const char *p = line;
+  const char *tok;
+  int n;
+
+  if (!(tok = next_token(p, n)) || !parse_uid(tok, n, t.uid, t.uid_size)) return false;
+  if (!(tok = next_token(p, n)) || !copy_name(tok, n, t.name)) return false;
+  if (!(tok = next_token(p, n))) return false;
+  t.x_mm = strtol(tok, NULL, 10);
+  if (!(tok = next_token(p, n))) return false;
+  t.y_mm = strtol(tok, NULL, 10);
+  t.num_neighbors = 0;
+
+  uint32_t us = probeUid(t.uid, t.uid_size);
+  uint32_t ns = probeName(t.name);
+  if (_uid_slots[us] != TAG_NONE || _name_slots[ns] != TAG_NONE) return false;
+  _uid_slots[us] = _count;
+  _name_slots[ns] = _count;
+  ++_count;
+  return true;
+}
+
+bool TagRegistry::linkLine(const char *line)
+{
+  if (skip_line(line)) return false;
+
+  const char *p = line;
+  const char *tok;
+  int n;
+  uint8_t uid[TAG_UID_MAX], size;
+
+  if (!(tok = next_token(p, n)) || !parse_uid(tok, n, uid, size)) return false;
+  uint16_t r = _uid_slots[probeUid(uid, size)];
+  if (r == TAG_NONE) return false;
+  TagRecord &t = _records[r];
+
+  // name, x, y
+  for (int i = 0; i < 3; ++i)
+    if (!next_token(p, n)) return false;
+
+  char name[TAG_NAME_LEN];
+  t.num_neighbors = 0;
+  while ((tok = next_token(p, n)) && t.num_neighbors < TAG_NEIGHBORS) {
+    if (!copy_name(tok, n, name)) continue;
+    const TagRecord *other = findName(name);
+    if (other) t.neighbors[t.num_neighbors++] = indexOf(other);
+  }
+  return true;
+}
+
+int TagRegistry::load(const char *text)
+{
+  clear();
+  for (const char *line = text; *line; ) {
+    addLine(line);
+    while (*line && *line++ != '\n') ;
+  }
+  for (const char *line = text; *line; ) {
+    linkLine(line);
+    while (*line && *line++ != '\n') ;
+  }
+  return _count;
+}
+
+#ifdef ARDUINO
+
+int TagRegistry::loadFile(const char *path)
+{
+  File f = SPIFFS.open(path, "r");
+  if (!f) return -1;
+
+  char line[TAG_LINE_LEN];
+  clear();
+  for (int pass = 0; pass < 2; ++pass) {
+    f.seek(0);
+    while (f.available()) {
+      size_t n = f.readBytesUntil('\n', line, sizeof(line) - 1);
+      line[n] = 0;
+      if (pass == 0) addLine(line);
+      else linkLine(line);
+    }
+  }
+  f.close();
+  return _count;
+}
+
+#else
+
+int TagRegistry::loadFile(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f) return -1;
+
+  char line[TAG_LINE_LEN];
+  clear();
+  for (int pass = 0; pass < 2; ++pass) {
+    rewind(f);
+    while (fgets(line, sizeof(line), f)) {
+      if (pass == 0) addLine(line);
+      else linkLine(line);
+    }
+  }
+  fclose(f);
+  return _count;
+}
+
+#endif
@@ -0,0 +1,94 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Location tag table with hashed lookup by full UID
+// ----------------------------------------------------------------------------
+
+#ifndef __TAGREGISTRY_H__
+#define __TAGREGISTRY_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TAG_UID_MAX      10   // triple size ISO 14443 UID
+#define TAG_NAME_LEN     16
+#define TAG_NEIGHBORS    4
+#define TAG_NONE         0xffff
+
+struct TagRecord {
+  uint8_t uid_size;
+  uint8_t uid[TAG_UID_MAX];
+  uint8_t num_neighbors;
+  char name[TAG_NAME_LEN];
+  int32_t x_mm;                       // position on the floor
+  int32_t y_mm;
+  uint16_t neighbors[TAG_NEIGHBORS];  // record indexes
+};
+
+// Records live in a caller-provided array, indexed by two open-addressing
+// hash tables (UID and name) with linear probing. Slot tables have a power
+// of two size of at least twice the capacity, so probe runs stay short;
+// a lookup hashes the key once and compares a few records, no allocation.
+//
+// The table is loaded from text, one tag per line:
+//   <uid hex> <name> <x mm> <y mm> [<neighbor name> ...]
+// e.g. "4c645b03 YELLOW 1200 300 RED GREEN". Blank lines and lines
+// starting with '#' are skipped. Neighbors are resolved by name in a
+// second pass, so they may refer to tags further down.
+class TagRegistry {
+  public:
+    TagRegistry(TagRecord *records, uint16_t capacity,
+                uint16_t *uid_slots, uint16_t *name_slots, uint32_t slot_count);
+
+    void clear();
+
+    // first pass: add the record, false if malformed, duplicate or full
+    bool addLine(const char *line);
+    // second pass: resolve the neighbor names of the line's tag
+    bool linkLine(const char *line);
+
+    // both passes over a whole text buffer, one tag per line
+    int load(const char *text);
+    // both passes over a file, SPIFFS on the ESP32; -1 if it can't be opened
+    int loadFile(const char *path);
+
+    const TagRecord *find(const uint8_t *uid, uint8_t size) const;
+    const TagRecord *findName(const char *name) const;
+    uint16_t indexOf(const TagRecord *r) const { return r - _records; }
+
+    uint16_t size() const { return _count; }
+    const TagRecord &operator[](uint16_t i) const { return _records[i]; }
+
+    // statistics
+    uint32_t maxProbe() const;       // longest probe run in the UID table
+
+    static uint32_t hashUid(const uint8_t *uid, uint8_t size);
+    static uint32_t hashName(const char *name);
+    static int formatUid(const uint8_t *uid, uint8_t size, char *out, int len);
+
+  private:
+    TagRecord *_records;
+    uint16_t _capacity;
+    uint16_t _count;
+    uint16_t *_uid_slots;
+    uint16_t *_name_slots;
+    uint32_t _mask;
+
+    uint32_t probeUid(const uint8_t *uid, uint8_t size) const;
+    uint32_t probeName(const char *name) const;
+};
+
+// registry with its own storage, e.g. a global TagTable<512>
+template <uint16_t N>
+class TagTable : public TagRegistry {
+  static_assert((N & (N - 1)) == 0, "table size must be a power of two");
+
+  public:
+    TagTable() : TagRegistry(_r, N, _u, _n, 2 * N) {}
+
+  private:
+    TagRecord _r[N];
+    uint16_t _u[2 * N];
+    uint16_t _n[2 * N];
+};
+
+#endif  // __TAGREGISTRY_H__
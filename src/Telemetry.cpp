@@ -0,0 +1,249 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Framed binary telemetry: writer and decoder
+// ----------------------------------------------------------------------------
+
+#include "Telemetry.h"
+#include "hal.h"
+#include <string.h>
+
+static const TlmSchema schemas[] = {
+  { TLM_MOTION,     "motion",     "dx,dy,squal",                                  3, 0x03, 0 },
+  { TLM_MOTION_ALL, "motion_all", "dx,dy,squal,shutter,max_pixel,pixel_sum",      6, 0x03, 0 },
+  { TLM_FRAME,      "frame",      "dx,dy",                                        2, 0x03, 225 },
+  { TLM_SAMPLE,     "sample",     "dx,dy,squal,flags",                            4, 0x03, 0 },
+  { TLM_FRAME_RLE,  "frame_rle",  "seq",                                          1, 0x00, TLM_BLOB_ANY },
+  { TLM_POSE,       "pose",       "x_mm,y_mm,heading_cdeg,v_fwd_mm_s,v_left_mm_s,omega_mrad_s", 6, 0x3f, 0 },
+  { TLM_TAG,        "tag",        "x_mm,y_mm",                                    2, 0x03, TLM_BLOB_ANY },
+  { TLM_DATAGRAM,   "datagram",   "seq,dropped",                                  2, 0x00, TLM_BLOB_ANY },
+};
+
+const TlmSchema *tlm_schema(uint8_t type)
+{
+  for (unsigned i = 0; i < sizeof(schemas) / sizeof(schemas[0]); ++i)
+    if (schemas[i].type == type) return &schemas[i];
+  return NULL;
+}
+
+uint16_t tlm_crc16(const uint8_t *data, size_t len, uint16_t crc)
+{
+  while (len--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (int i = 0; i < 8; ++i)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+
+TelemetryWriter::TelemetryWriter()
+{
+  _len = 0;
+  _frame = 0;
+  _overflow = false;
+  _last_us = 0;
+  _since_abs = TLM_ABS_EVERY;
+  frames = 0;
+  bytes = 0;
+  overflows = 0;
+}
+
+inline void TelemetryWriter::put(uint8_t b)
+{
+  if (_len - _frame - TLM_HEADER >= TLM_MAX_PAYLOAD) {
+    _overflow = true;
+    return;
+  }
+  _buf[_len++] = b;
+}
+
+void TelemetryWriter::begin(uint8_t type, uint32_t t_us)
+{
+  if (_len + TLM_MAX_FRAME > TLM_BUFFER_SIZE) flush();
+
+  bool abs_time = ++_since_abs >= TLM_ABS_EVERY;
+  if (abs_time) _since_abs = 0;
+
+  _frame = _len;
+  _overflow = false;
+  _buf[_len++] = TLM_SYNC0;
+  _buf[_len++] = TLM_SYNC1;
+  _buf[_len++] = type | (abs_time ? TLM_ABS_TIME : 0);
+  _buf[_len++] = 0;   // length, set by end()
+  putUnsigned(abs_time ? t_us : t_us - _last_us);
+  _last_us = t_us;
+}
+
+void TelemetryWriter::putUnsigned(uint32_t v)
+{
+  while (v >= 0x80) {
+    put((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  put(v);
+}
+
+void TelemetryWriter::putSigned(int32_t v)
+{
+  putUnsigned(zigzag(v));
+}
+
+void TelemetryWriter::putBytes(const uint8_t *data, size_t len)
+{
+  while (len--) put(*data++);
+}
+
+bool TelemetryWriter::end()
+{
+  if (_overflow) {
+    // the timestamp went out with the dropped frame, resend it in full
+    _len = _frame;
+    _since_abs = TLM_ABS_EVERY;
+    ++overflows;
+    return false;
+  }
+  size_t payload = _len - _frame - TLM_HEADER;
+  _buf[_frame + 3] = payload;
+  uint16_t crc = tlm_crc16(_buf + _frame + 2, payload + 2);
+  _buf[_len++] = crc & 0xff;
+  _buf[_len++] = crc >> 8;
+  ++frames;
+  bytes += _len - _frame;
+  return true;
+}
+
+void TelemetryWriter::writeSample(const MotionSample &s)
+{
+  begin(TLM_SAMPLE, s.t_us);
+  putSigned(s.dx);
+  putSigned(s.dy);
+  putUnsigned(s.squal);
+  putUnsigned(s.flags);
+  end();
+}
+
+void TelemetryWriter::writePose(const Pose &p)
+{
+  begin(TLM_POSE, p.t_us);
+  putSigned((int32_t)(p.x_um / 1000));
+  putSigned((int32_t)(p.y_um / 1000));
+  putSigned((int32_t)(((int64_t)(int32_t)p.heading * 18000) >> 31));
+  putSigned(p.v_fwd_mm_s);
+  putSigned(p.v_left_mm_s);
+  putSigned(p.omega_mrad_s);
+  end();
+}
+
+void TelemetryWriter::writeTag(uint32_t t_us, const char *name, int32_t x_mm, int32_t y_mm)
+{
+  begin(TLM_TAG, t_us);
+  putSigned(x_mm);
+  putSigned(y_mm);
+  putBytes((const uint8_t *)name, strlen(name));
+  end();
+}
+
+void TelemetryWriter::restart()
+{
+  _len = 0;
+  _since_abs = TLM_ABS_EVERY;
+}
+
+void TelemetryWriter::flush()
+{
+  if (_len == 0) return;
+  Serial.write(_buf, _len);
+  _len = 0;
+}
+
+
+TelemetryDecoder::TelemetryDecoder()
+{
+  _len = 0;
+  _time_valid = false;
+  _t_us = 0;
+  frames = 0;
+  crc_errors = 0;
+  unknown = 0;
+  skipped = 0;
+}
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+  v = 0;
+  for (int shift = 0; shift < 35 && p < end; shift += 7) {
+    uint8_t b = *p++;
+    v |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+bool TelemetryDecoder::parse(TelemetryRecord &out)
+{
+  const uint8_t *p = _buf + TLM_HEADER;
+  const uint8_t *end = p + _buf[3];
+  uint8_t type = _buf[2];
+
+  uint32_t t;
+  if (!get_varint(p, end, t)) return false;
+  if (type & TLM_ABS_TIME) {
+    _t_us = t;
+    _time_valid = true;
+  } else {
+    _t_us += t;
+  }
+
+  const TlmSchema *schema = tlm_schema(type & ~TLM_ABS_TIME);
+  if (!schema) {
+    ++unknown;
+    return false;
+  }
+
+  out.type = schema->type;
+  out.time_valid = _time_valid;
+  out.t_us = _t_us;
+  out.num_fields = schema->num_fields;
+  for (int i = 0; i < schema->num_fields; ++i) {
+    uint32_t v;
+    if (!get_varint(p, end, v)) return false;
+    out.fields[i] = (schema->signed_mask & (1 << i)) ? unzigzag(v) : (int32_t)v;
+  }
+  out.blob = p;
+  out.blob_len = end - p;
+  return !schema->blob || schema->blob == TLM_BLOB_ANY || out.blob_len == schema->blob;
+}
+
+bool TelemetryDecoder::push(uint8_t b, TelemetryRecord &out)
+{
+  // hunt for the sync word
+  if ((_len == 0 && b != TLM_SYNC0) || (_len == 1 && b != TLM_SYNC1)) {
+    ++skipped;
+    _len = (b == TLM_SYNC0) ? 1 : 0;
+    return false;
+  }
+  _buf[_len++] = b;
+  if (_len < TLM_HEADER || _len < (size_t)TLM_HEADER + _buf[3] + TLM_TRAILER) return false;
+
+  size_t payload = _buf[3];
+  _len = 0;
+  uint16_t crc = _buf[TLM_HEADER + payload] | (_buf[TLM_HEADER + payload + 1] << 8);
+  if (tlm_crc16(_buf + 2, payload + 2) != crc) {
+    // the time base is lost with the frame
+    ++crc_errors;
+    _time_valid = false;
+    return false;
+  }
+  ++frames;
+  return parse(out);
+}
@@ -0,0 +1,133 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Framed binary telemetry: writer and decoder
+// ----------------------------------------------------------------------------
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FlowSensor.h"
+#include "Pose.h"
+
+// Frame layout, all in one buffer:
+//   0xa5 0x5a  type  length  payload[length]  crc16 (lo, hi)
+// The CRC (CCITT, init 0xffff) covers type, length and payload. The
+// payload starts with the timestamp in us as a varint: the difference to
+// the previous frame, or the absolute time if the type has TLM_ABS_TIME
+// set (every TLM_ABS_EVERY frames, so a decoder that lost a frame can pick
+// up again). Fields follow as varints, signed ones zigzag encoded, then
+// the raw bytes of types that carry a blob.
+
+#define TLM_SYNC0        0xa5
+#define TLM_SYNC1        0x5a
+#define TLM_ABS_TIME     0x80
+#define TLM_ABS_EVERY    32
+#define TLM_HEADER       4
+#define TLM_TRAILER      2
+#define TLM_MAX_PAYLOAD  255
+#define TLM_MAX_FRAME    (TLM_HEADER + TLM_MAX_PAYLOAD + TLM_TRAILER)
+#define TLM_BUFFER_SIZE  1024
+#define TLM_MAX_FIELDS   8
+
+// record types
+#define TLM_MOTION       0x01   // dx, dy, squal
+#define TLM_MOTION_ALL   0x02   // dx, dy, squal, shutter, max_pixel, pixel_sum
+#define TLM_FRAME        0x03   // dx, dy, pixels[225]
+#define TLM_SAMPLE       0x04   // dx, dy, squal, flags (a Sampler MotionSample)
+#define TLM_FRAME_RLE    0x05   // seq, encoded pixels (see frame_encode())
+#define TLM_POSE         0x06   // x, y, heading, forward/left speed, turn rate (a Pose)
+#define TLM_TAG          0x07   // x, y, name (a tag arrival)
+#define TLM_DATAGRAM     0x08   // seq, dropped, vehicle id (starts each UDP datagram)
+
+#define TLM_BLOB_ANY     0xff   // schema: blob of any length
+
+uint16_t tlm_crc16(const uint8_t *data, size_t len, uint16_t crc = 0xffff);
+
+// Builds frames back to back in a preallocated buffer; flush() hands the
+// whole buffer to Serial in one write, begin() flushes by itself when the
+// next frame might not fit.
+class TelemetryWriter {
+  public:
+    TelemetryWriter();
+
+    void begin(uint8_t type, uint32_t t_us);
+    void putUnsigned(uint32_t v);
+    void putSigned(int32_t v);
+    void putBytes(const uint8_t *data, size_t len);
+    bool end();             // false if the payload overflowed, frame dropped
+
+    void writeSample(const MotionSample &s);   // one TLM_SAMPLE frame
+    void writePose(const Pose &p);             // one TLM_POSE frame
+    void writeTag(uint32_t t_us, const char *name, int32_t x_mm, int32_t y_mm);
+
+    const uint8_t *data() const { return _buf; }
+    size_t size() const { return _len; }
+    void clear() { _len = 0; }
+    void restart();         // clear, the next frame carries the absolute time
+    void flush();
+
+    // statistics
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t overflows;
+
+  private:
+    uint8_t _buf[TLM_BUFFER_SIZE];
+    size_t _len;
+    size_t _frame;          // start of the frame being built
+    bool _overflow;
+    uint32_t _last_us;
+    uint8_t _since_abs;
+
+    void put(uint8_t b);
+};
+
+struct TelemetryRecord {
+  uint8_t type;             // without TLM_ABS_TIME
+  bool time_valid;          // false until the first absolute time
+  uint32_t t_us;
+  uint8_t num_fields;
+  int32_t fields[TLM_MAX_FIELDS];
+  const uint8_t *blob;      // points into the decoder, valid until the next push()
+  uint8_t blob_len;
+};
+
+// Byte-wise decoder: push() returns true when a frame completed with a
+// good CRC. Bad frames are counted and skipped by hunting for the next
+// sync word.
+class TelemetryDecoder {
+  public:
+    TelemetryDecoder();
+
+    bool push(uint8_t b, TelemetryRecord &out);
+
+    // statistics
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t unknown;       // good frames of a type without a schema
+    uint32_t skipped;       // bytes dropped while hunting for sync
+
+  private:
+    uint8_t _buf[TLM_MAX_FRAME];
+    size_t _len;
+    bool _time_valid;
+    uint32_t _t_us;
+
+    bool parse(TelemetryRecord &out);
+};
+
+// field layout of a record type
+struct TlmSchema {
+  uint8_t type;
+  const char *name;
+  const char *columns;      // CSV header of the fields
+  uint8_t num_fields;
+  uint8_t signed_mask;      // bit i: field i is zigzag encoded
+  uint8_t blob;             // raw bytes after the fields (0: none, or TLM_BLOB_ANY)
+};
+
+const TlmSchema *tlm_schema(uint8_t type);   // NULL if unknown
+
+#endif  // __TELEMETRY_H__
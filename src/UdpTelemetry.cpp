@@ -0,0 +1,144 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Batched pose and tag telemetry over UDP
+// ----------------------------------------------------------------------------
+
+#include "UdpTelemetry.h"
+#include "hal.h"
+#include <string.h>
+
+#ifndef ARDUINO
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+UdpTelemetry::UdpTelemetry(WifiLink &link, const char *vehicle, uint32_t pose_ms, uint32_t send_ms)
+  : _link(link)
+{
+  _vehicle = vehicle;
+  this->pose_ms = pose_ms;
+  this->send_ms = send_ms;
+  records = coalesced = datagrams = sent = dropped = send_errors = bytes_sent = 0;
+  _head = _count = 0;
+  _seq = 0;
+  _pose_ms = _send_ms = 0;
+  _posed = false;
+  _open = false;
+#ifndef ARDUINO
+  _sock = -1;
+  _host = 0;
+#endif
+  _port = 0;
+}
+
+void UdpTelemetry::begin(const char *host, uint16_t port)
+{
+  _port = port;
+#ifdef ARDUINO
+  _host.fromString(host);
+#else
+  _host = inet_addr(host);
+  _sock = socket(AF_INET, SOCK_DGRAM, 0);
+#endif
+}
+
+void UdpTelemetry::open(uint32_t t_us)
+{
+  _writer.restart();
+  _writer.begin(TLM_DATAGRAM, t_us);
+  _writer.putUnsigned(_seq++);
+  _writer.putUnsigned(dropped);
+  _writer.putBytes((const uint8_t *)_vehicle, strlen(_vehicle));
+  _writer.end();
+  _open = true;
+}
+
+// close the open datagram if the next record might not fit, the writer
+// would flush it to Serial otherwise
+void UdpTelemetry::room()
+{
+  if (_open && _writer.size() + TLM_MAX_FRAME > TLM_BUFFER_SIZE) close();
+}
+
+void UdpTelemetry::close()
+{
+  if (!_open) return;
+  if (_count == UDP_TLM_QUEUE) {
+    _head = (_head + 1) % UDP_TLM_QUEUE;
+    --_count;
+    ++dropped;
+  }
+  Datagram &d = _queue[(_head + _count) % UDP_TLM_QUEUE];
+  d.len = _writer.size();
+  memcpy(d.data, _writer.data(), d.len);
+  ++_count;
+  ++datagrams;
+  _open = false;
+}
+
+void UdpTelemetry::pose(const Pose &p, uint32_t now_ms)
+{
+  if (_link.state() == LINK_OFF) return;
+  if (_posed && now_ms - _pose_ms < pose_ms) {
+    ++coalesced;
+    return;
+  }
+  _posed = true;
+  _pose_ms = now_ms;
+  room();
+  if (!_open) open(p.t_us);
+  _writer.writePose(p);
+  ++records;
+}
+
+void UdpTelemetry::tag(uint32_t t_us, const char *name, int32_t x_mm, int32_t y_mm)
+{
+  if (_link.state() == LINK_OFF) return;
+  room();
+  if (!_open) open(t_us);
+  _writer.writeTag(t_us, name, x_mm, y_mm);
+  ++records;
+}
+
+bool UdpTelemetry::send(const Datagram &d)
+{
+#ifdef ARDUINO
+  if (!_udp.beginPacket(_host, _port)) return false;
+  _udp.write(d.data, d.len);
+  return _udp.endPacket() == 1;
+#else
+  if (_sock < 0) return false;
+  struct sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_port = htons(_port);
+  to.sin_addr.s_addr = _host;
+  return sendto(_sock, d.data, d.len, MSG_DONTWAIT, (struct sockaddr *)&to, sizeof(to)) == d.len;
+#endif
+}
+
+uint32_t UdpTelemetry::update(uint32_t now_ms)
+{
+  if (!_link.up()) return send_ms;
+
+  if (now_ms - _send_ms >= send_ms) {
+    _send_ms = now_ms;
+    close();
+  }
+  // a failed send keeps the datagram for the next round
+  for (int i = 0; i < UDP_TLM_BURST && _count > 0; ++i) {
+    const Datagram &d = _queue[_head];
+    if (!send(d)) {
+      ++send_errors;
+      break;
+    }
+    ++sent;
+    bytes_sent += d.len;
+    _head = (_head + 1) % UDP_TLM_QUEUE;
+    --_count;
+  }
+  if (_count > 0) return 1;
+  uint32_t wait = send_ms - (now_ms - _send_ms);
+  return wait > 0 ? wait : 1;
+}
@@ -0,0 +1,87 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Batched pose and tag telemetry over UDP
+// ----------------------------------------------------------------------------
+
+#ifndef __UDPTELEMETRY_H__
+#define __UDPTELEMETRY_H__
+
+#include <stdint.h>
+#include "Telemetry.h"
+#include "WifiLink.h"
+
+#ifdef ARDUINO
+#include <WiFiUdp.h>
+#endif
+
+#define UDP_TLM_QUEUE     8     // datagrams kept while the link is down
+#define UDP_TLM_BURST     4     // datagrams sent per update at most
+
+// Telemetry frames (see Telemetry.h) packed into UDP datagrams of up to
+// TLM_BUFFER_SIZE bytes. Each datagram starts with a TLM_DATAGRAM record
+// (sequence number, datagrams dropped so far, vehicle id) and the
+// absolute time, so the dashboard decodes it on its own and sees losses
+// as gaps in the sequence.
+//
+// Poses are kept at most every pose_ms, tag arrivals always. While the
+// link is up the open datagram goes out every send_ms; while it is down
+// datagrams are only closed when full and wait in a queue of
+// UDP_TLM_QUEUE slots, the oldest one is dropped for a new one. Nothing
+// is allocated and update() sends at most UDP_TLM_BURST datagrams. With
+// the link off (no SSID) records are not even kept.
+class UdpTelemetry {
+  public:
+    UdpTelemetry(WifiLink &link, const char *vehicle, uint32_t pose_ms, uint32_t send_ms);
+
+    void begin(const char *host, uint16_t port);
+
+    void pose(const Pose &p, uint32_t now_ms);
+    void tag(uint32_t t_us, const char *name, int32_t x_mm, int32_t y_mm);
+    uint32_t update(uint32_t now_ms);   // ms until the next update is due
+
+    uint32_t pose_ms;
+    uint32_t send_ms;
+
+    // statistics
+    uint32_t records;
+    uint32_t coalesced;       // poses left out by pose_ms
+    uint32_t datagrams;       // closed
+    uint32_t sent;
+    uint32_t dropped;         // oldest datagrams given up for new ones
+    uint32_t send_errors;
+    uint32_t bytes_sent;
+
+  private:
+    struct Datagram {
+      uint16_t len;
+      uint8_t data[TLM_BUFFER_SIZE];
+    };
+
+    WifiLink &_link;
+    const char *_vehicle;
+    TelemetryWriter _writer;          // the open datagram
+    Datagram _queue[UDP_TLM_QUEUE];
+    uint8_t _head;                    // oldest
+    uint8_t _count;
+    uint32_t _seq;
+    uint32_t _pose_ms;
+    uint32_t _send_ms;
+    bool _posed;
+    bool _open;
+
+#ifdef ARDUINO
+    WiFiUDP _udp;
+    IPAddress _host;
+#else
+    int _sock;
+    uint32_t _host;
+#endif
+    uint16_t _port;
+
+    void open(uint32_t t_us);
+    void room();
+    void close();
+    bool send(const Datagram &d);
+};
+
+#endif  // __UDPTELEMETRY_H__
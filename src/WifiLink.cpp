@@ -0,0 +1,165 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// WiFi connection manager
+// ----------------------------------------------------------------------------
+
+#include "WifiLink.h"
+
+static const char *state_names[LINK_STATES] = { "off", "connecting", "up", "backoff" };
+
+const char *link_state_name(LinkState state)
+{
+  return state < LINK_STATES ? state_names[state] : "?";
+}
+
+WifiLink *WifiLink::_instance = 0;
+
+#define LINK_EVENT_GOT_IP 1
+#define LINK_EVENT_LOST   2
+
+void WifiLink::event(int id)
+{
+  if (!_instance) return;
+  if (id == LINK_EVENT_GOT_IP) _instance->_got_ip = true;
+  if (id == LINK_EVENT_LOST) _instance->_lost = true;
+  if (_instance->_notify) _instance->_notify(_instance->_notify_ctx);
+}
+
+#ifdef ARDUINO
+
+#include <WiFi.h>
+
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+#define WIFI_GOT_IP       ARDUINO_EVENT_WIFI_STA_GOT_IP
+#define WIFI_DISCONNECTED ARDUINO_EVENT_WIFI_STA_DISCONNECTED
+#else
+#define WIFI_GOT_IP       SYSTEM_EVENT_STA_GOT_IP
+#define WIFI_DISCONNECTED SYSTEM_EVENT_STA_DISCONNECTED
+#endif
+
+static void wifi_event(WiFiEvent_t id)
+{
+  if (id == WIFI_GOT_IP) WifiLink::event(LINK_EVENT_GOT_IP);
+  if (id == WIFI_DISCONNECTED) WifiLink::event(LINK_EVENT_LOST);
+}
+
+static void link_setup()
+{
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);   // the backoff here decides
+  WiFi.onEvent(wifi_event);
+}
+
+static void link_start(const char *ssid, const char *password)
+{
+  WiFi.begin(ssid, password);
+}
+
+static void link_stop()
+{
+  WiFi.disconnect();
+}
+
+#else
+
+static bool host_ap = true;
+
+void WifiLink::hostAccessPoint(bool up)
+{
+  host_ap = up;
+  if (!up) event(LINK_EVENT_LOST);
+}
+
+static void link_setup() {}
+
+// the loopback "access point" answers right away, or not at all
+static void link_start(const char *, const char *)
+{
+  if (host_ap) WifiLink::event(LINK_EVENT_GOT_IP);
+}
+
+static void link_stop() {}
+
+#endif
+
+WifiLink::WifiLink(const char *ssid, const char *password, uint32_t connect_ms,
+                   uint32_t backoff_min_ms, uint32_t backoff_max_ms)
+{
+  _ssid = ssid;
+  _password = password;
+  this->connect_ms = connect_ms;
+  this->backoff_min_ms = backoff_min_ms;
+  this->backoff_max_ms = backoff_max_ms;
+  attempts = connects = disconnects = up_ms = 0;
+  _state = LINK_OFF;
+  _due_ms = _last_ms = 0;
+  _backoff_ms = backoff_min_ms;
+  _got_ip = _lost = false;
+  _notify = 0;
+  _notify_ctx = 0;
+}
+
+void WifiLink::begin(uint32_t now_ms)
+{
+  if (!_ssid || !_ssid[0]) return;
+  _instance = this;
+  link_setup();
+  _last_ms = now_ms;
+  attempt(now_ms);
+}
+
+void WifiLink::attempt(uint32_t now_ms)
+{
+  ++attempts;
+  _state = LINK_CONNECTING;
+  _due_ms = now_ms + connect_ms;
+  link_start(_ssid, _password);
+}
+
+void WifiLink::backoff(uint32_t now_ms)
+{
+  _state = LINK_BACKOFF;
+  _due_ms = now_ms + _backoff_ms;
+  _backoff_ms = _backoff_ms * 2 < backoff_max_ms ? _backoff_ms * 2 : backoff_max_ms;
+}
+
+uint32_t WifiLink::update(uint32_t now_ms)
+{
+  if (_state == LINK_OFF) return 0;
+  if (_state == LINK_UP) up_ms += now_ms - _last_ms;
+  _last_ms = now_ms;
+
+  // a loss before the address of the next attempt, in the order they came
+  if (_lost) {
+    _lost = false;
+    if (_state == LINK_UP) {
+      ++disconnects;
+      link_stop();
+      backoff(now_ms);
+    }
+  }
+  if (_got_ip) {
+    _got_ip = false;
+    if (_state == LINK_CONNECTING) {
+      ++connects;
+      _state = LINK_UP;
+      _backoff_ms = backoff_min_ms;
+    }
+  }
+
+  switch (_state) {
+    case LINK_CONNECTING:
+      if ((int32_t)(now_ms - _due_ms) >= 0) {
+        link_stop();
+        backoff(now_ms);
+      }
+      break;
+    case LINK_BACKOFF:
+      if ((int32_t)(now_ms - _due_ms) >= 0) attempt(now_ms);
+      break;
+    default:
+      return backoff_min_ms;  // up: the events do the work
+  }
+  int32_t wait = _due_ms - now_ms;
+  return wait > 0 ? wait : 1;
+}
@@ -0,0 +1,81 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// WiFi connection manager
+// ----------------------------------------------------------------------------
+
+#ifndef __WIFILINK_H__
+#define __WIFILINK_H__
+
+#include <stdint.h>
+
+enum LinkState {
+  LINK_OFF,         // no SSID, or not started
+  LINK_CONNECTING,  // association and DHCP under way
+  LINK_UP,          // got an address
+  LINK_BACKOFF,     // waiting before the next attempt
+  LINK_STATES
+};
+
+const char *link_state_name(LinkState state);
+
+// Keeps the station connected without ever waiting for it. The WiFi
+// driver reports "got IP" and "disconnected" as events; update() turns
+// them into states and starts the next attempt. An attempt that brings no
+// address within connect_ms is given up, the next one follows after a
+// backoff that doubles from backoff_min_ms up to backoff_max_ms and starts
+// over once connected. update() returns when it wants to run again, and
+// notify() names who to wake up when an event came in meanwhile.
+//
+// On the host the loopback interface stands in: the access point is up
+// unless the bench switches it off with hostAccessPoint().
+class WifiLink {
+  public:
+    typedef void (*NotifyFn)(void *ctx);   // called from the WiFi event task
+
+    WifiLink(const char *ssid, const char *password, uint32_t connect_ms = 10000,
+             uint32_t backoff_min_ms = 1000, uint32_t backoff_max_ms = 30000);
+
+    void begin(uint32_t now_ms);        // first attempt, LINK_OFF without an SSID
+    void notify(NotifyFn fn, void *ctx) { _notify = fn; _notify_ctx = ctx; }
+    uint32_t update(uint32_t now_ms);   // ms until the next update is due
+
+    LinkState state() const { return _state; }
+    bool up() const { return _state == LINK_UP; }
+
+    static void event(int id);          // from the driver's event handler
+
+#ifndef ARDUINO
+    static void hostAccessPoint(bool up);
+#endif
+
+    uint32_t connect_ms;
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+
+    // statistics
+    uint32_t attempts;
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t up_ms;                     // time connected, up to the last update
+
+  private:
+    const char *_ssid;
+    const char *_password;
+    LinkState _state;
+    uint32_t _due_ms;
+    uint32_t _backoff_ms;
+    uint32_t _last_ms;
+    NotifyFn _notify;
+    void *_notify_ctx;
+
+    // set by the WiFi event handler (another task), taken by update()
+    volatile bool _got_ip;
+    volatile bool _lost;
+
+    static WifiLink *_instance;
+
+    void attempt(uint32_t now_ms);
+    void backoff(uint32_t now_ms);
+};
+
+#endif  // __WIFILINK_H__
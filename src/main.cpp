@@ -1,9 +1,29 @@
 #include <Arduino.h>
 #include <SSD1306.h>
+#include "StatusScreen.h"
+#include "DisplayService.h"
 #include <SPI.h>
+#include "SpiBus.h"
 #include <MFRC522.h>
+#include "CardWatch.h"
+#include "TagReader.h"
+#include "TagRegistry.h"
+#include <SPIFFS.h>
 #include "MCS12085.h"
+#include "MCS12085Fast.h"
+#include "Sampler.h"
+#include "FlowFusion.h"
+#include "Pose.h"
+#include "PowerManager.h"
+#include "Startup.h"
+#include "AdaptivePoll.h"
+#include "Scheduler.h"
+#include "Profiler.h"
 #include <WiFi.h>
+#include "WifiLink.h"
+#include "UdpTelemetry.h"
+#include <LoRa.h>
+#include "LoraReporter.h"
 
 
 // RFID with MFRC-522
@@ -19,6 +39,12 @@
 #define LORA_RST     14   
 #define LORA_DI0     26  
 #define LORA_BAND    868E6
+#define LORA_SF      7
+#define LORA_BW      125000
+#define LORA_CR      5    // 4/5
+#define LORA_PREAMBLE 8
+#define LORA_TX_DBM  14
+#define LORA_RESET_MS 10
 
 
 #define RFID_SDA 5 
@@ -26,6 +52,9 @@
 #define RFID_MOSI 23
 #define RFID_MISO 19
 #define RFID_RST 22
+#define RFID_IRQ 38
+#define RFID_REQA_MS 50 // background card request period
+#define RFID_PRESENT_MS 250 // check if the last tag is still in the field
 
 #define OLED_I2C_ADDR 0x3C
 #define OLED_RESET 16
@@ -34,258 +63,655 @@
 
 #define MOUSE_SCLK 17
 #define MOUSE_SDIO 13
+#define MOUSE_COUNTS_PER_M 20000 // 20 dots per mm
+#define MOUSE_X_MM 0 // mounting point from the center of rotation, x forward
+#define MOUSE_Y_MM 0 // y left
 // #define MOUSE_NCS 25
 // #define MOUSE_NRST -1 
 
-#define SPI_NONE -1
-#define SPI_RFID 0
-#define SPI_LORA 1
-
-// some colored RFID location tags
-#define LOC_START   0x0
-// #define LOC_YELLOW  0xBC325E03
-// #define LOC_RED     0x224016D0
-// #define LOC_GREEN   0xACA2Ce03
-// #define LOC_BLUE    0X7ED6B912
-// #define LOC_GRAY    0xEC05D503
-// #define LOC_BLACK   0x1CD9CE03  
-#define LOC_YELLOW  0x4c645b03
-#define LOC_RED     0x823e77d0
-#define LOC_GREEN   0xec85ce03
-#define LOC_BLUE    0Xce04ba12
-#define LOC_GRAY    0x2c31d403
-#define LOC_BLACK   0x5c34ca03  
-
-#define NUM_TAGS 6
-
-SSD1306 display(OLED_I2C_ADDR, OLED_SDA, OLED_SCL);
-
-// mouse sensor
-MCS12085 mouse(MOUSE_SCLK, MOUSE_SDIO);
+// second mouse sensor for the heading, away from the first one
+// #define MOUSE2_SCLK 21
+// #define MOUSE2_SDIO 12
+#define MOUSE2_X_MM 0
+#define MOUSE2_Y_MM -120
+
+#define LORA_SPI_CLOCK 8000000
+
+// location tags, from SPIFFS (pio run -t uploadfs) or the built-in set
+// of colored tags: <uid> <name> <x mm> <y mm> [<neighbors>]
+#define TAGS_FILE "/tags.txt"
+#define TAGS_MAX 512
+const char *default_tags =
+  "4c645b03 YELLOW 0 0\n"
+  "823e77d0 RED 0 0\n"
+  "ec85ce03 GREEN 0 0\n"
+  "ce04ba12 BLUE 0 0\n"
+  "2c31d403 GRAY 0 0\n"
+  "5c34ca03 BLACK 0 0\n";
+// older tag set
+// bc325e03 YELLOW, 224016d0 RED, aca2ce03 GREEN, 7ed6b912 BLUE, ec05d503 GRAY, 1cd9ce03 BLACK
+
+DiffSSD1306 display(OLED_I2C_ADDR, OLED_SDA, OLED_SCL);
+StatusScreen screen(display);
+
+// the OLED is drawn and flushed on core 0, loop() only posts snapshots
+#define DISPLAY_INTERVAL_MS 200 // 5x/sec
+#define DISPLAY_CORE 0
+DisplayService display_service(render_status_screen, &screen, DISPLAY_INTERVAL_MS);
+
+// mouse sensor, pins and bus timing fixed at compile time; any FlowSensor
+// (MCS12085, ADNS5020 and their Fast variants) fits here
+typedef MCS12085Fast<MOUSE_SCLK, MOUSE_SDIO> Mouse;
+Mouse mouse;
+
+// background sampling of the mouse sensor on core 0 (loop() runs on core 1),
+// 1 ms when moving fast, 50 ms when standing still
+#define MOUSE_PERIOD_US 5000
+#define MOUSE_PERIOD_MIN_US 1000
+#define MOUSE_PERIOD_MAX_US 50000
+#define MOUSE_CORE 0
+Sampler sampler(read_sensor<Mouse>, &mouse, MOUSE_PERIOD_US);
+AdaptivePoll mouse_poll(MOUSE_PERIOD_MIN_US, MOUSE_PERIOD_MAX_US);
+
+#ifdef MOUSE2_SCLK
+typedef MCS12085Fast<MOUSE2_SCLK, MOUSE2_SDIO> Mouse2;
+Mouse2 mouse2;
+Sampler sampler2(read_sensor<Mouse2>, &mouse2, MOUSE_PERIOD_US);
+#endif
+
+// vehicle pose from the mouse sensor(s), heading needs two of them or
+// tags with coordinates; any task may read() it
+FlowFusion fusion;
+PoseTracker pose;
 
 // rfid
 MFRC522 mfrc522(RFID_SDA, RFID_RST); 
+CardWatch card_watch(mfrc522, RFID_IRQ, RFID_REQA_MS);
+TagReader tag_reader(mfrc522);
 
 
-long distance;
-ulong location = LOC_START; // 32bit RFID UID of last seen tag
-ulong destination = LOC_START;
+int64_t leg_start_um = 0; // forward travel when the destination was set
+TagTable<TAGS_MAX> tags;
+bool tags_mapped = false; // any tag with coordinates, fixes for the pose
+TagRecord unknown_tag; // last seen tag that is not in the table
+const TagRecord *location = NULL; // last seen tag, NULL at the start
+const TagRecord *destination = NULL;
 
-int current_spi = SPI_NONE; 
+// RFID and LoRa share the SPI peripheral on different pins
+SpiBus spi_bus(SPI);
+int spi_rfid = SPI_NONE;
+int spi_lora = SPI_NONE;
 char buffer[80];
 bool info_update = false; // display update flag
 
 const char *vehicle_id = "IMOB-A";
-const char *color[] = { "START", "YELLOW", "RED", "GREEN", "BLUE", "GRAY", "BLACK" };
-const ulong tags[] = { LOC_START, LOC_YELLOW, LOC_RED, LOC_GREEN, LOC_BLUE, LOC_GRAY, LOC_BLACK };
 
-wl_status_t wifi_status = WL_DISCONNECTED;
-
-
-const char* uid_to_color(ulong uid) 
+// WiFi link and the fleet dashboard feed, poses 5x/sec batched into one
+// datagram per second; no SSID: WiFi stays off
+#define WIFI_SSID ""
+#define WIFI_PASSWORD ""
+#define FLEET_HOST "192.168.1.10"
+#define FLEET_PORT 4210
+#define FLEET_POSE_MS 200
+#define FLEET_SEND_MS 1000
+WifiLink wifi_link(WIFI_SSID, WIFI_PASSWORD);
+UdpTelemetry fleet(wifi_link, vehicle_id, FLEET_POSE_MS, FLEET_SEND_MS);
+
+// LoRa reports while WiFi is down: 0.9% duty (1% allowed in the 868 MHz
+// sub-band, the rest for a 2 s burst), a pose every 5 s at most
+#define LORA_VEHICLE 1
+#define LORA_DUTY_PPM 9000
+#define LORA_BURST_MS 2000
+#define LORA_POSE_MS 5000
+bool lora_send(void *, const uint8_t *data, uint8_t len);
+const LoraParams lora_params = { LORA_SF, LORA_BW, LORA_CR, LORA_PREAMBLE };
+LoraReporter lora(lora_send, NULL, LORA_VEHICLE, lora_params,
+                  LORA_DUTY_PPM, LORA_BURST_MS, LORA_POSE_MS);
+
+
+const char* tag_name(const TagRecord *tag) 
 {
-  for (int i=0; i<=NUM_TAGS; ++i)
-    if (uid == tags[i])
-      return color[i];
-  return itoa(uid, buffer, 16);
+  return tag ? tag->name : "START";
 }
 
-const ulong color_to_uid(const char* col) 
+// table entry for a UID, unknown tags get their UID as name
+const TagRecord *tag_lookup(const byte *uid, byte size) 
 {
-  for (int i=0; i<=NUM_TAGS; ++i)
-    if (strcmp(col, color[i]) == 0)
-      return tags[i];
-  return 0;
+  const TagRecord *tag = tags.find(uid, size);
+  if (tag) return tag;
+  unknown_tag.uid_size = size;
+  memcpy(unknown_tag.uid, uid, size);
+  TagRegistry::formatUid(uid, size, unknown_tag.name, TAG_NAME_LEN);
+  return &unknown_tag;
 }
 
 // check if we have arrived at destination
 // set a new (random) destination
 void check_location() 
 {  
-  if (location == destination) {
-    ulong new_dest = destination;
+  if (location == destination && tags.size() > (destination ? 1 : 0)) {
+    const TagRecord *new_dest = destination;
     while (new_dest == destination) 
-      new_dest = tags[1 + random(NUM_TAGS)];
+      new_dest = &tags[random(tags.size())];
     destination = new_dest;
-    distance = 0;
+    leg_start_um = pose.pose().fwd_um;
     info_update = true;
 
-    // Serial.print("new destination: "); Serial.println(uid_to_color(destination));
+    // Serial.print("new destination: "); Serial.println(tag_name(destination));
   }
 }
 
 
-// switch SPI config on-the-fly
-void spi_select(int which) {
-     if (which == current_spi) return;
-     SPI.end();
-     
-     switch(which) {
-        case SPI_RFID:
-          SPI.begin(RFID_SCK, RFID_MISO, RFID_MOSI);
-          mfrc522.PCD_Init();   
-        break;
-        case SPI_LORA:
-          SPI.begin(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_SS);
-          // LoRa.setPins(LORA_SS,LORA_RST,LORA_DI0);
-        break;
-     }
+// the reader keeps its configuration across bus switches unless the
+// LoRa traffic on its pins upset it
+bool rfid_alive(void *reader) {
+  byte v = static_cast<MFRC522 *>(reader)->PCD_ReadRegister(MFRC522::VersionReg);
+  return v != 0x00 && v != 0xff;
+}
 
-     current_spi = which;
+void rfid_init(void *reader) {
+  static_cast<MFRC522 *>(reader)->PCD_Init();
+  card_watch.configure(); // PCD_Init() cleared the IRQ setup
 }
 
-// convert 4-byte array to 32bit long
-long uid_to_long(byte array[]) 
-{
-  long l = array[0];
-  for (int i=1; i<4; ++i) {
-    l = l<<8;
-    l |= array[i];
-  }
-  return l;
+void spi_setup() {
+  spi_rfid = spi_bus.add("rfid", RFID_SCK, RFID_MISO, RFID_MOSI, RFID_SDA,
+                         SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0),
+                         rfid_alive, rfid_init, &mfrc522);
+  spi_lora = spi_bus.add("lora", LORA_SCK, LORA_MISO, LORA_MOSI, LORA_SS,
+                         SPISettings(LORA_SPI_CLOCK, MSBFIRST, SPI_MODE0));
 }
 
-// update display
+// copy the current status into a snapshot for the display task
 void info() {
-  display.clear();
-  int y = 0;
+  PROFILE_SCOPE("info");
+  StatusSnapshot s;
+  strlcpy(s.vehicle, vehicle_id, sizeof(s.vehicle));
+  strlcpy(s.ip, WiFi.localIP().toString().c_str(), sizeof(s.ip));
+  strlcpy(s.location, tag_name(location), sizeof(s.location));
+  strlcpy(s.destination, tag_name(destination), sizeof(s.destination));
+  Pose p;
+  if (pose.read(p)) s.distance_mm = (p.fwd_um - leg_start_um) / 1000; // since the last destination
+  else s.distance_mm = 0;
+  display_service.post(s);
+}
 
-  display.setFont(ArialMT_Plain_10);
-  display.drawString(0, y, vehicle_id);
-  //display.drawString(100, 0, itoa(wifi_status, buffer, 10));
-  display.drawString(43, y, WiFi.localIP().toString());
-  // display.drawLine(0,11, 128,11);
 
-  y = 43;
-  // display.setFont(ArialMT_Plain_16);
-  display.drawString(0, y, "@");
-  // display.drawString(20, y, location_uid);
-  //display.drawString(20, y, itoa(location, buffer, 16));
-  display.drawString(20, y, uid_to_color(location));
+// startup units: the peripherals come up side by side, each one with its
+// own waits, and the tasks that need it start when it is ready
+#define OLED_RESET_MS 50
+#define MOUSE_INIT_MS 100
+#define RFID_POWER_MS 30
+#define RFID_RETRY_MS 100
+#define WIFI_POLL_MS 500
+#define WIFI_POLLS 20 // startup waits this long for the link, it keeps trying
+
+Startup startup;
+int oled_unit = -1;
+int mouse_unit = -1;
+int rfid_unit = -1;
+int tags_unit = -1;
+int lora_unit = -1;
+int wifi_unit = -1;
+uint32_t first_sample_ms = 0; // time to the first mouse sample, 0: none yet
+
+
+// look for a new tag: true with the time the tag answered, so the
+// odometry can be split at the moment of contact
+long last_present = 0;
+bool read_tag(long now, uint32_t &contact_us)
+{
+  bool found = false;
 
-  // display.setFont(ArialMT_Plain_10);
-  long mm = distance / 20; // travelled distence in mm
-  display.drawString(90, y, itoa(mm, buffer, 10)); 
+  // the reader is only touched when a card answered or a request is due
+  if (!card_watch.pending() && !card_watch.due(now)) return false;
+  {
+    PROFILE_SCOPE("spi switch");
+    spi_bus.acquire(spi_rfid);
+  }
 
-  y = 53;
-  display.drawString(0, y, ">>");
-  display.drawString(20, y, uid_to_color(destination));
-  display.display();
+  if (card_watch.pending() && card_watch.answered()) {
+    contact_us = card_watch.irq_us();
+    if (tag_reader.read() == TagReader::NEW) {
+      location = tag_lookup(tag_reader.uid().uidByte, tag_reader.uid().size);
+      info_update = true;
+      found = true;
+    }
+    tag_reader.halt(); // not answering REQA while it stays in the field
+  } else if (tag_reader.cached() && now - last_present > RFID_PRESENT_MS) {
+    last_present = now;
+    tag_reader.present();
+  }
+
+  card_watch.arm(now);
+  spi_bus.release();
+  return found;
 }
 
 
-void wifi_connect() {
-  wifi_status = WiFi.begin("ssid", "pwd");
-  info();
+// loop() tasks, earliest deadline first
+#define RFID_TASK_US 5000
+#define ODOMETRY_TASK_US 20000
+#define SERIAL_TASK_US 100000
+Scheduler scheduler;
+int rfid_task_id;
+int odometry_task_id;
+int display_task_id;
+int serial_task_id;
+int power_task_id;
+int startup_task_id;
+int link_task_id;
+int lora_task_id;
+
+// idle vehicle: slower polling after 5 s without motion or tags, asleep
+// after 60 s; asleep, the mouse is checked every 500 ms
+#define POWER_SLOW_MS 5000
+#define POWER_SLEEP_MS 60000
+#define POWER_CHECK_MS 500
+#define POWER_PROBE_MS 0 // sensor wake-up time, 50 for an ADNS5020 (tPD)
+#define MOUSE_PERIOD_SLOW_US 200000
+#define RFID_REQA_SLOW_MS 250
+#define RFID_TASK_SLOW_US 50000
+#define ODOMETRY_TASK_SLOW_US 100000
+#define SERIAL_TASK_SLEEP_US 1000000
+
+void power_apply(void *, PowerState state);
+bool power_check(void *);
+PowerManager power(power_apply, power_check, NULL,
+                   POWER_SLOW_MS, POWER_SLEEP_MS, POWER_CHECK_MS, POWER_PROBE_MS);
+bool rf_field_on = true;
+
+bool tag_arrived = false;
+uint32_t tag_contact_us = 0;
+
+// card answers and background requests
+void rfid_task(void *)
+{
+  PROFILE_SCOPE("rfid");
+  if (read_tag(millis(), tag_contact_us)) {
+    power.activity(millis());
+    tag_arrived = true;
+    scheduler.signal(odometry_task_id); // split the odometry right away
+  }
+}
 
-  int retry = 20;
-  while ((wifi_status = WiFi.status()) != WL_CONNECTED && retry > 0)
-  {
-    Serial.print(".");
+// pose update from everything the samplers collected; at a tag contact
+// the motion up to it goes in first, so the fix lands where the tag is
+MotionSample samples[16];
+FlowMotion motion;
+
+void advance(uint32_t t_us)
+{
+  if (fusion.solve(motion)) {
+    pose.update(motion, t_us);
+    fleet.pose(pose.pose(), millis());
+    lora.pose(pose.pose());
+    if (motion.dx_um != 0 || motion.dy_um != 0) {
+      info_update = true;
+      power.activity(millis());
+    }
+  }
+}
+
+void arrive()
+{
+  advance(tag_contact_us);
+  if (tags_mapped && location != &unknown_tag)
+    pose.fix(location->x_mm, location->y_mm, tag_contact_us);
+  fleet.tag(tag_contact_us, location->name, location->x_mm, location->y_mm);
+  lora.tag(pose.pose(), location == &unknown_tag ? FLEET_TAG_UNKNOWN : tags.indexOf(location), millis());
+  scheduler.signal(lora_task_id);
+  check_location();
+  tag_arrived = false;
+}
+
+// the second sensor is taken whole, for a batch split at a tag contact the
+// fusion holds the rotation of the batch before
+void odometry_task(void *)
+{
+  PROFILE_SCOPE("odometry");
+  uint32_t n;
+  while ((n = sampler.drain(samples, 16)) > 0) {
+    if (first_sample_ms == 0) {
+      first_sample_ms = samples[0].t_us / 1000;
+      Serial.print("first sample at "); Serial.print(first_sample_ms); Serial.println(" ms");
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+      if (tag_arrived && (int32_t)(samples[i].t_us - tag_contact_us) >= 0) arrive();
+      fusion.add(0, samples[i]);
+    }
+  }
+#ifdef MOUSE2_SCLK
+  while ((n = sampler2.drain(samples, 16)) > 0)
+    for (uint32_t i = 0; i < n; ++i)
+      fusion.add(1, samples[i]);
+#endif
+  if (tag_arrived) arrive();
+  advance(micros());
+}
+
+// display snapshot 5x/sec, the display task draws it
+void display_task(void *)
+{
+  if (info_update) {
+    info_update = false;
     info();
-    retry--;
-    delay(500);
   }
+}
 
-  if (retry == 0)
-  {
-    Serial.println("WiFi connection failed");
-  } else {
-    Serial.println("WiFi connected"); 
+// serial commands: 'p' dumps the stage profile, 'r' resets it
+void serial_task(void *)
+{
+  while (Serial.available()) {
+    switch (Serial.read()) {
+      case 'p': profiler_dump(); break;
+      case 'r': profiler_reset(); break;
+    }
   }
-  Serial.print("IP: "); Serial.println(WiFi.localIP());
+}
 
-  info();
+// state changes, and the period until the manager wants to run again
+void power_task(void *)
+{
+  scheduler.setPeriod(power_task_id, power.update(millis()) * 1000L);
 }
 
+// WiFi events and the fleet datagrams, never waits for the network
+void link_wake(void *)
+{
+  scheduler.signal(link_task_id);
+}
 
-void setup()
+void link_task(void *)
 {
-  Serial.begin(115200);
-  delay(100);
-
-  // reset the OLED
-  pinMode(OLED_RESET, OUTPUT);
-  digitalWrite(OLED_RESET, LOW);
-  delay(50);
-  digitalWrite(OLED_RESET, HIGH);
-
-  display.init();
-  display.flipScreenVertically();
-  display.setFont(ArialMT_Plain_10);
-  display.setTextAlignment(TEXT_ALIGN_LEFT);
-  display.drawString(0, 0, "START");
-
-  mouse.init();
-  delay(100);
-
-  // SPI.begin();                       // Init SPI bus
-  spi_select(SPI_RFID);
-  delay(30);
-  mfrc522.PCD_Init();
-
-  // retry?
-  if (mfrc522.PCD_ReadRegister(mfrc522.VersionReg) == 0) {
-    delay(100);
-    mfrc522.PCD_Init();
+  uint32_t now = millis();
+  uint32_t wait_ms = wifi_link.update(now);
+  uint32_t send_ms = fleet.update(now);
+  if (send_ms < wait_ms) wait_ms = send_ms;
+  scheduler.setPeriod(link_task_id, wait_ms * 1000L);
+}
+
+// the radio is not waited for: a packet still on the air refuses the next
+bool lora_send(void *, const uint8_t *data, uint8_t len)
+{
+  spi_bus.acquire(spi_lora);
+  bool ok = LoRa.beginPacket();
+  if (ok) {
+    LoRa.write(data, len);
+    LoRa.endPacket(true);
   }
-  mfrc522.PCD_DumpVersionToSerial(); // Show details of PCD - MFRC522 Card Reader details
-  display.drawString(100, 0, itoa(mfrc522.PCD_ReadRegister(mfrc522.VersionReg),buffer, 16));
-  // Serial.println(F("Scan PICC to see UID, SAK, type, and data blocks..."));
+  spi_bus.release();
+  return ok;
+}
 
-  display.display();
+// LoRa is the fallback, nothing goes out while WiFi carries the telemetry
+void lora_task(void *)
+{
+  if (!startup.ready(lora_unit)) return;
+  lora.enabled = !wifi_link.up();
+  scheduler.setPeriod(lora_task_id, lora.update(millis()) * 1000L);
+}
 
-  check_location();
+void startup_report()
+{
+  for (int i = 0; i < startup.count(); ++i) {
+    const Startup::Unit &u = startup.unit(i);
+    Serial.printf("%-6s %-7s at %5u ms (%u us busy)\n", u.name, startup_state_name(u.state),
+                  u.ready_ms - startup.begin_ms(), u.busy_us);
+  }
+}
 
-  // wifi_connect();
+// the next startup step, the report when all units are through
+void startup_task(void *)
+{
+  uint32_t wait_ms = startup.run(millis());
+  scheduler.setPeriod(startup_task_id, wait_ms * 1000L);
+  if (wait_ms == 0) startup_report();
 }
 
+// tasks of a unit that did not come up stay off
+void task_period(int unit, int task, uint32_t period_us)
+{
+  if (startup.ready(unit)) scheduler.setPeriod(task, period_us);
+}
 
+void rf_field(bool on)
+{
+  if (on == rf_field_on || !startup.ready(rfid_unit)) return;
+  spi_bus.acquire(spi_rfid);
+  if (on) {
+    mfrc522.PCD_AntennaOn();
+    card_watch.arm(millis());
+  } else {
+    mfrc522.PCD_AntennaOff();
+  }
+  spi_bus.release();
+  rf_field_on = on;
+}
 
+void power_apply(void *, PowerState state)
+{
+  switch (state) {
+    case POWER_ACTIVE:
+      mouse.wake();
+      sampler.pause(false);
+      mouse_poll.max_us = MOUSE_PERIOD_MAX_US;
+      rf_field(true);
+      card_watch.setPeriod(RFID_REQA_MS);
+      task_period(rfid_unit, rfid_task_id, RFID_TASK_US);
+      task_period(mouse_unit, odometry_task_id, ODOMETRY_TASK_US);
+      scheduler.setPeriod(display_task_id, DISPLAY_INTERVAL_MS * 1000L);
+      scheduler.setPeriod(serial_task_id, SERIAL_TASK_US);
+      break;
+    case POWER_SLOW:
+      mouse_poll.max_us = MOUSE_PERIOD_SLOW_US;
+      card_watch.setPeriod(RFID_REQA_SLOW_MS);
+      task_period(rfid_unit, rfid_task_id, RFID_TASK_SLOW_US);
+      task_period(mouse_unit, odometry_task_id, ODOMETRY_TASK_SLOW_US);
+      break;
+    case POWER_SLEEP:
+      // the sampler leaves the mouse alone from its next period on, long
+      // before the first check
+      sampler.pause(true);
+      mouse.sleep();
+      rf_field(false);
+      scheduler.setPeriod(rfid_task_id, 0);
+      scheduler.setPeriod(odometry_task_id, 0);
+      scheduler.setPeriod(display_task_id, 0);
+      scheduler.setPeriod(serial_task_id, SERIAL_TASK_SLEEP_US);
+      break;
+    case POWER_PROBE:
+      mouse.wake();
+      break;
+    default:
+      break;
+  }
+}
 
-long last_mouse = 0;
-long last_info = 0;
+// asleep: did the vehicle move? (the counts of this read are not odometry)
+bool power_check(void *)
+{
+  MotionSample s;
+  return mouse.sample(s) && (s.dx != 0 || s.dy != 0);
+}
 
-void loop()
+// rfid and odometry start as event tasks, their startup unit gives them
+// the period
+void scheduler_setup()
 {
-  long now = millis();
-
-  // mouse position update
-  if (now - last_mouse > 30) {
-    last_mouse = now;
-
-    // calling these in quick succession seems to work faster
-    int x = mouse.read_x(); // distance moved in dots (-127 to 128)
-    int y = mouse.read_y(); // distance moved in dots (-127 to 128)
-    double delta = sqrt(x*x + y*y);
-    distance += delta;
-    info_update |= (delta > 0);  
+  rfid_task_id = scheduler.add("rfid", rfid_task, NULL, 0, 0, 2);
+  odometry_task_id = scheduler.add("odometry", odometry_task, NULL, 0, 0, 1);
+  display_task_id = scheduler.add("display", display_task, NULL, DISPLAY_INTERVAL_MS * 1000L);
+  serial_task_id = scheduler.add("serial", serial_task, NULL, SERIAL_TASK_US);
+  power_task_id = scheduler.add("power", power_task, NULL, POWER_SLOW_MS * 1000L);
+  startup_task_id = scheduler.add("startup", startup_task, NULL, 0);
+  link_task_id = scheduler.add("link", link_task, NULL, 0);
+  lora_task_id = scheduler.add("lora", lora_task, NULL, 0);
+  scheduler.signal(startup_task_id);
+  power.activity(millis());
+}
+
+
+int32_t oled_step(void *, uint16_t step)
+{
+  switch (step) {
+    case 0:
+      pinMode(OLED_RESET, OUTPUT);
+      digitalWrite(OLED_RESET, LOW);
+      return OLED_RESET_MS;
+    default:
+      digitalWrite(OLED_RESET, HIGH);
+      display.init();
+      display.flipScreenVertically();
+      display.setFont(ArialMT_Plain_10);
+      display.setTextAlignment(TEXT_ALIGN_LEFT);
+      display.drawString(0, 0, "START");
+      display.display();
+      display_service.start(DISPLAY_CORE);
+      return STARTUP_DONE;
   }
+}
 
+int32_t mouse_step(void *, uint16_t step)
+{
+  switch (step) {
+    case 0:
+      mouse.init();
+#ifdef MOUSE2_SCLK
+      mouse2.init();
+#endif
+      return MOUSE_INIT_MS;
+    default:
+      sampler.setAdaptive(&mouse_poll);
+      sampler.start(MOUSE_CORE);
+      fusion.addSensor(FlowMount { MOUSE_X_MM, MOUSE_Y_MM, 0, 1e6f / MOUSE_COUNTS_PER_M, 1, 0 });
+#ifdef MOUSE2_SCLK
+      sampler2.start(MOUSE_CORE);
+      fusion.addSensor(FlowMount { MOUSE2_X_MM, MOUSE2_Y_MM, 0, 1e6f / MOUSE_COUNTS_PER_M, 1, 0 });
+#endif
+      task_period(mouse_unit, odometry_task_id, ODOMETRY_TASK_US);
+      return STARTUP_DONE;
+  }
+}
 
-  spi_select(SPI_RFID);
-  
-  // Look for new cards
-  if (mfrc522.PICC_IsNewCardPresent())
-  if (mfrc522.PICC_ReadCardSerial())
-  {
-    // Dump debug info about the card; PICC_HaltA() is automatically called
-    // mfrc522.PICC_DumpToSerial(&(mfrc522.uid));
-    // mfrc522.PICC_DumpDetailsToSerial(&(mfrc522.uid));
-    mfrc522.PICC_HaltA();
-    location = uid_to_long(mfrc522.uid.uidByte);
-    check_location();
-    info_update = true;
+// the bus stays with the reader until it is configured; LoRa is not up yet
+int32_t rfid_ready()
+{
+  mfrc522.PCD_DumpVersionToSerial(); // Show details of PCD - MFRC522 Card Reader details
+  card_watch.begin();
+  card_watch.arm(millis());
+  spi_bus.release();
+  task_period(rfid_unit, rfid_task_id, RFID_TASK_US);
+  return STARTUP_DONE;
+}
+
+int32_t rfid_step(void *, uint16_t step)
+{
+  switch (step) {
+    case 0:
+      spi_setup();
+      spi_bus.acquire(spi_rfid);
+      return RFID_POWER_MS;
+    case 1:
+      mfrc522.PCD_Init();
+      if (mfrc522.PCD_ReadRegister(mfrc522.VersionReg) != 0) return rfid_ready();
+      return RFID_RETRY_MS;
+    default:
+      mfrc522.PCD_Init();
+      return rfid_ready();
   }
+}
 
+// reset by hand, LoRa.begin() would wait for it; the reader set up the
+// bus before
+int32_t lora_step(void *, uint16_t step)
+{
+  switch (step) {
+    case 0:
+      pinMode(LORA_RST, OUTPUT);
+      digitalWrite(LORA_RST, LOW);
+      return LORA_RESET_MS;
+    case 1:
+      digitalWrite(LORA_RST, HIGH);
+      return LORA_RESET_MS;
+    default: {
+      spi_bus.acquire(spi_lora);
+      LoRa.setSPIFrequency(LORA_SPI_CLOCK);
+      LoRa.setPins(LORA_SS, -1, LORA_DI0);
+      bool ok = LoRa.begin(LORA_BAND);
+      if (ok) {
+        LoRa.setSpreadingFactor(LORA_SF);
+        LoRa.setSignalBandwidth(LORA_BW);
+        LoRa.setCodingRate4(LORA_CR);
+        LoRa.setPreambleLength(LORA_PREAMBLE);
+        LoRa.setTxPower(LORA_TX_DBM);
+        LoRa.enableCrc();
+      }
+      spi_bus.release();
+      if (!ok) return STARTUP_FAILED;
+      scheduler.signal(lora_task_id);
+      return STARTUP_DONE;
+    }
+  }
+}
 
-  // display update 5x/sec
-  if ((now - last_info > 200) && info_update) {
-    last_info = now;
-    info_update = false;
-    info();
+int32_t tags_step(void *, uint16_t)
+{
+  if (!SPIFFS.begin() || tags.loadFile(TAGS_FILE) <= 0)
+    tags.load(default_tags);
+  Serial.print("tags: "); Serial.println(tags.size());
+  for (int i = 0; i < tags.size(); ++i)
+    tags_mapped |= (tags[i].x_mm != 0 || tags[i].y_mm != 0);
+  check_location();
+  return STARTUP_DONE;
+}
+
+// the display shows the address once connected, no redraw per attempt
+int32_t wifi_step(void *, uint16_t step)
+{
+  if (step == 0) {
+    wifi_link.notify(link_wake, NULL);
+    wifi_link.begin(millis());
+    fleet.begin(FLEET_HOST, FLEET_PORT);
+    scheduler.signal(link_task_id);
+    return WIFI_POLL_MS;
   }
+  if (wifi_link.up()) {
+    Serial.print("IP: "); Serial.println(WiFi.localIP());
+    info_update = true;
+    return STARTUP_DONE;
+  }
+  if (step >= WIFI_POLLS) {
+    Serial.println("WiFi not connected, retrying in the background");
+    return STARTUP_FAILED;
+  }
+  return WIFI_POLL_MS;
+}
 
-  // delay(50);
+void setup()
+{
+  Serial.begin(115200);
 
-}
\ No newline at end of file
+  oled_unit = startup.add("oled", oled_step, NULL);
+  mouse_unit = startup.add("mouse", mouse_step, NULL);
+  rfid_unit = startup.add("rfid", rfid_step, NULL);
+  tags_unit = startup.add("tags", tags_step, NULL);
+  lora_unit = startup.add("lora", lora_step, NULL, rfid_unit);
+  if (WIFI_SSID[0]) wifi_unit = startup.add("wifi", wifi_step, NULL);
+  scheduler_setup();
+}
+
+
+void loop()
+{
+  if (scheduler.runOnce()) return;
+
+  // nothing ready: wait for the next release instead of spinning, in
+  // light sleep when the vehicle stands. The WiFi station does not survive
+  // light sleep, so with a link it stays at delay() (modem sleep) and the
+  // dashboard keeps seeing the parked vehicle.
+  uint32_t idle_us = scheduler.idle();
+  if (idle_us < 2000) return;
+  if (power.asleep() && wifi_link.state() == LINK_OFF) hal_light_sleep_us(idle_us);
+  else delay(idle_us / 1000);
+}
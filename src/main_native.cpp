@@ -0,0 +1,1876 @@
+// ----------------------------------------------------------------------------
+// IMOB VEHICLE
+// Host (native) runner: drivers against simulated sensors
+// ----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "SimBus.h"
+#include "SimMCS12085.h"
+#include "SimADNS5020.h"
+#include "MCS12085.h"
+#include "MCS12085Fast.h"
+#include "ADNS5020.h"
+#include "ADNS5020Fast.h"
+#include "Sampler.h"
+#include "Odometer.h"
+#include "AdaptivePoll.h"
+#include "FrameDiff.h"
+#include "DisplayService.h"
+#include "TagRegistry.h"
+#include "Scheduler.h"
+#include "Profiler.h"
+#include "Telemetry.h"
+#include "FramePipe.h"
+#include "FlowFusion.h"
+#include "Pose.h"
+#include "PowerManager.h"
+#include "Startup.h"
+#include "WifiLink.h"
+#include "UdpTelemetry.h"
+#include "LoraReporter.h"
+#include "SimRadio.h"
+#include <math.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <type_traits>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+// same wiring as on the vehicle (see main.cpp)
+#define MOUSE_SCLK 17
+#define MOUSE_SDIO 13
+
+#define CAM_SCLK   32
+#define CAM_SDIO   33
+#define CAM_NCS    25
+#define CAM_NRESET 12
+
+// cost of one digitalWrite/digitalRead on the ESP32 Arduino core,
+// and of a single GPIO register access
+#define ESP32_GPIO_NS 150
+#define ESP32_GPIO_REG_NS 25
+
+static void report(const char *what, int samples, uint64_t busy_ns, uint32_t violations)
+{
+  printf("%-10s %6d samples  %8.1f us/sample  %u timing violations\n",
+         what, samples, busy_ns / 1000.0 / samples, violations);
+}
+
+// drive the MCS12085 at a constant speed and compare the summed deltas
+// with what the surface actually moved
+static int run_mouse(int samples)
+{
+  SimBus &bus = sim_bus();
+  MCS12085 mouse(MOUSE_SCLK, MOUSE_SDIO);
+  mouse.init();
+
+  SimMCS12085 chip(bus, MOUSE_SCLK, MOUSE_SDIO);
+  chip.motion.setVelocity(60, 25, bus.now());   // mm/s
+
+  long sx = 0, sy = 0;
+  uint64_t busy = 0;
+  for (int i = 0; i < samples; ++i) {
+    hal_delay_ms(30);
+    uint64_t t0 = bus.now();
+    MCS12085::Delta d = mouse.read_xy();
+    sx += d.dx;
+    sy += d.dy;
+    busy += bus.now() - t0;
+  }
+
+  report("mcs12085", samples, busy, chip.violations);
+  printf("           read %ld,%ld  true %ld,%ld  lost %ld,%ld\n",
+         sx, sy, chip.motion.true_x, chip.motion.true_y,
+         chip.motion.lost_x, chip.motion.lost_y);
+  return 0;
+}
+
+static int run_cam(int samples)
+{
+  SimBus &bus = sim_bus();
+  SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+  ADNS5020 cam(CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET, 1000);
+  cam.reset();
+  cam.identify();
+  chip.motion.setVelocity(40, -10, bus.now());
+
+  uint64_t busy = 0;
+  for (int i = 0; i < samples; ++i) {
+    hal_delay_ms(10);
+    uint64_t t0 = bus.now();
+    cam.readBurst();
+    busy += bus.now() - t0;
+  }
+  report("adns5020", samples, busy, chip.violations);
+  printf("           read %d,%d  true %ld,%ld  lost %ld,%ld\n",
+         cam.x, cam.y, chip.motion.true_x, chip.motion.true_y,
+         chip.motion.lost_x, chip.motion.lost_y);
+  return 0;
+}
+
+// readDelta() as one merged transaction against the four single reads it
+// used to be, then resolution() rewritten every sample and power cycles:
+// bytes and bus time per call, writes that reached the chip
+static int run_txn(int samples)
+{
+  SimBus &bus = sim_bus();
+  SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+  ADNS5020 cam(CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET, 1000);
+  cam.reset();
+  chip.motion.setVelocity(40, -10, bus.now());
+
+  for (int mode = 0; mode < 2; ++mode) {
+    uint32_t bytes0 = cam.bytes_clocked;
+    uint64_t busy = 0;
+    long sx = 0, sy = 0;
+    uint8_t motion, dx, dy, squal;
+    for (int i = 0; i < samples; ++i) {
+      hal_delay_ms(10);
+      uint64_t t0 = bus.now();
+      if (mode) {
+        cam.readDelta();
+        sx += cam.dx;
+        sy += cam.dy;
+      } else {
+        // one commit per register: nothing to merge
+        cam.queueRead(ADNS5020_REG_MOTION, &motion);
+        cam.commit(false);
+        cam.queueRead(ADNS5020_REG_DELTA_X, &dx);
+        cam.commit(false);
+        cam.queueRead(ADNS5020_REG_DELTA_Y, &dy);
+        cam.commit(false);
+        cam.queueRead(ADNS5020_REG_SQUAL, &squal);
+        cam.commit();
+        sx += (int8_t)dx;
+        sy += (int8_t)dy;
+      }
+      busy += bus.now() - t0;
+    }
+    printf("txn        %-12s %5.1f bytes, %6.1f us/call, %u violations, read %ld,%ld\n",
+           mode ? "merged" : "single reads", (double)(cam.bytes_clocked - bytes0) / samples,
+           busy / 1000.0 / samples, chip.violations, sx, sy);
+  }
+
+  uint32_t writes0 = chip.control_writes;
+  for (int i = 0; i < samples; ++i) {
+    cam.resolution(i % 100 == 99 ? 500 : 1000);
+    cam.readDelta();
+  }
+  printf("           resolution() per sample: %u CONTROL writes, %u skipped\n",
+         chip.control_writes - writes0, cam.skipped_writes);
+
+  writes0 = chip.control_writes;
+  uint64_t t0 = bus.now();
+  long moved = 0;
+  for (int i = 0; i < 10; ++i) {
+    cam.powerDown();
+    hal_delay_ms(100);
+    cam.readBurst();
+    moved += cam.dx;
+  }
+  printf("           10 power cycles (100 ms down): %u CONTROL writes, %.1f ms each, %u violations, %u merged reads\n",
+         chip.control_writes - writes0, (bus.now() - t0) / 1e7, chip.violations, cam.merged_reads);
+  return chip.violations == 0 ? 0 : 1;
+}
+
+// pin-specialized drivers: same scenarios as above
+static int run_fast(int samples)
+{
+  SimBus &bus = sim_bus();
+  {
+    MCS12085Fast<MOUSE_SCLK, MOUSE_SDIO> mouse;
+    mouse.init();
+    SimMCS12085 chip(bus, MOUSE_SCLK, MOUSE_SDIO);
+    chip.motion.setVelocity(60, 25, bus.now());
+
+    long sx = 0, sy = 0;
+    uint64_t busy = 0;
+    for (int i = 0; i < samples; ++i) {
+      hal_delay_ms(30);
+      uint64_t t0 = bus.now();
+      MCS12085::Delta d = mouse.read_xy();
+      busy += bus.now() - t0;
+      sx += d.dx;
+      sy += d.dy;
+    }
+    report("mcs-fast", samples, busy, chip.violations);
+    printf("           read %ld,%ld  true %ld,%ld  contentions %u\n",
+           sx, sy, chip.motion.true_x, chip.motion.true_y, bus.contentions);
+  }
+  {
+    SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+    ADNS5020Fast<CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET> cam;
+    cam.init(1000);
+    chip.motion.setVelocity(40, -10, bus.now());
+
+    uint64_t busy = 0;
+    for (int i = 0; i < samples; ++i) {
+      hal_delay_ms(10);
+      uint64_t t0 = bus.now();
+      cam.readBurst();
+      busy += bus.now() - t0;
+    }
+    report("adns-fast", samples, busy, chip.violations);
+    printf("           read %d,%d  true %ld,%ld  contentions %u\n",
+           cam.x, cam.y, chip.motion.true_x, chip.motion.true_y, bus.contentions);
+  }
+  return 0;
+}
+
+// synthetic sensor: every sample carries a sequence number
+static uint32_t next_seq;
+static bool read_seq(void *, MotionSample &s)
+{
+  s.t_us = next_seq++;
+  if ((next_seq & 0xff) == 0) std::this_thread::yield();  // single-core hosts
+  s.dx = s.dy = 1;
+  s.squal = 0;
+  s.flags = SAMPLE_MOTION;
+  return true;
+}
+
+// stress the ring: producer thread as fast as it can go, consumer drains
+// in batches; samples must arrive in order, and everything that did not
+// arrive must have been counted as dropped by the producer
+static int run_ring(int samples)
+{
+  next_seq = 0;
+  Sampler sampler(read_seq, NULL, 0);
+  sampler.start();
+
+  MotionSample batch[16];
+  uint32_t expect = 0, received = 0, batches = 0, disorder = 0;
+  bool stopped = false;
+  for (;;) {
+    if (!stopped && received >= (uint32_t)samples) {
+      sampler.stop();
+      stopped = true;
+    }
+    uint32_t n = sampler.drain(batch, 16);
+    if (n == 0) {
+      if (stopped) break;
+      std::this_thread::yield();
+      continue;
+    }
+    ++batches;
+    for (uint32_t i = 0; i < n; ++i) {
+      if (batch[i].t_us < expect) ++disorder;
+      expect = batch[i].t_us + 1;
+      ++received;
+    }
+  }
+
+  uint32_t lost = next_seq - received;
+  printf("ring       %u produced, %u received in %u batches, %u lost, %u dropped, %u out of order\n",
+         next_seq, received, batches, lost, sampler.dropped(), disorder);
+  return (lost == sampler.dropped() && disorder == 0) ? 0 : 1;
+}
+
+// MCS12085Fast sampled in the background at 200 Hz
+static int run_sampler(int samples)
+{
+  SimBus &bus = sim_bus();
+  MCS12085Fast<MOUSE_SCLK, MOUSE_SDIO> mouse;
+  mouse.init();
+  SimMCS12085 chip(bus, MOUSE_SCLK, MOUSE_SDIO);
+  chip.motion.setVelocity(600, 0, bus.now());
+
+  Sampler sampler(read_sensor<MCS12085Fast<MOUSE_SCLK, MOUSE_SDIO> >, &mouse, 5000);
+  sampler.start();
+
+  MotionSample batch[16];
+  long sx = 0;
+  int received = 0;
+  while (received < samples) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    uint32_t n = sampler.drain(batch, 16);
+    for (uint32_t i = 0; i < n; ++i) sx += batch[i].dx;
+    received += n;
+  }
+  sampler.stop();
+
+  printf("sampler    %u samples, max jitter %u us, %u late, %u dropped, read %ld true %ld\n",
+         sampler.samples, sampler.max_jitter_us, sampler.late, sampler.dropped(),
+         sx, chip.motion.true_x);
+  return 0;
+}
+
+// deterministic pseudo-random deltas
+static uint32_t lcg = 1;
+static int rand_delta(int range)
+{
+  lcg = lcg * 1664525 + 1013904223;
+  return (int)((lcg >> 8) % (2 * range + 1)) - range;
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point t0, int n)
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now() - t0).count() / (double)n;
+}
+
+// one Odometer step against round(length * 2^16), axes clamped like it
+static bool odometry_step_ok(int x, int y, uint32_t wrong)
+{
+  double cx = x < -ODO_STEP_MAX ? -ODO_STEP_MAX : x > ODO_STEP_MAX ? ODO_STEP_MAX : x;
+  double cy = y < -ODO_STEP_MAX ? -ODO_STEP_MAX : y > ODO_STEP_MAX ? ODO_STEP_MAX : y;
+  uint32_t expect = (uint32_t)floor(sqrt(cx * cx + cy * cy) * ODO_ONE + 0.5);
+  uint32_t got = Odometer::step_q16(x, y);
+  if (got != expect && wrong < 5) printf("  step (%d, %d): %u, expected %u\n", x, y, got, expect);
+  return got == expect;
+}
+
+// the old loop() path (double sqrt, truncated into a long) against the
+// fixed-point Odometer and an exact long double reference. The point is the
+// error; host times say nothing about the ESP32 (hardware double sqrt here,
+// soft-float there) and are only printed to catch regressions.
+static int run_odometry(int samples)
+{
+  static const int ranges[] = { 3, 20, 60, 127 };
+  static int8_t dx[1 << 16], dy[1 << 16];
+
+  for (unsigned r = 0; r < sizeof(ranges) / sizeof(ranges[0]); ++r) {
+    lcg = 1;
+    for (int i = 0; i < (1 << 16); ++i) {
+      dx[i] = rand_delta(ranges[r]);
+      dy[i] = (i & 3) ? rand_delta(ranges[r]) : 0;   // some straight runs
+    }
+
+    long double exact = 0;
+    for (int i = 0; i < samples; ++i) {
+      int x = dx[i & 0xffff], y = dy[i & 0xffff];
+      exact += sqrtl((long double)(x * x + y * y));
+    }
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    volatile long distance = 0;
+    for (int i = 0; i < samples; ++i) {
+      int x = dx[i & 0xffff], y = dy[i & 0xffff];
+      double delta = sqrt(x*x + y*y);
+      distance += delta;
+    }
+    double ns_old = elapsed_ns(t0, samples);
+
+    Odometer odo(20000);
+    Odometer::step_q16(1, 1);     // builds the table outside the timing
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; ++i)
+      odo.add(dx[i & 0xffff], dy[i & 0xffff]);
+    double ns_new = elapsed_ns(t0, samples);
+
+    double odo_counts = odo.total_q16() / (double)ODO_ONE;
+    printf("odometry   |d|<=%-3d %d samples: error double %.1f, fixed %.4f counts; "
+           "host double %.2f ns, fixed %.2f ns\n",
+           ranges[r], samples, (double)(distance - exact), (double)(odo_counts - exact),
+           ns_old, ns_new);
+  }
+
+  // single steps against the rounded exact length: all of |d| <= 300 (past
+  // the table, and the +-256 of 500 CPI samples scaled to 1000 CPI), the
+  // int16 edges, and clamping beyond them
+  static const int edges[][2] = {
+    { 254, 254 }, { -256, 10 }, { 32767, 32767 }, { -32768, -32768 }, { 32768, 1 },
+    { 0, -32768 }, { 40000, 0 }, { -100000, 100000 },
+  };
+  uint32_t wrong = 0, checked = 0;
+  for (int x = -300; x <= 300; ++x)
+    for (int y = -300; y <= 300; ++y, ++checked)
+      wrong += !odometry_step_ok(x, y, wrong);
+  for (unsigned i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i, ++checked)
+    wrong += !odometry_step_ok(edges[i][0], edges[i][1], wrong);
+  printf("odometry   %u single steps, %u wrong\n", checked, wrong);
+  return wrong ? 1 : 0;
+}
+
+// vehicle speed in mm/s over an 8 s run: stand, accelerate to 3 m/s,
+// cruise, brake, stand
+static float speed_profile(uint64_t t_ns)
+{
+  double t = t_ns * 1e-9;
+  if (t < 2) return 0;
+  if (t < 4) return 1500 * (t - 2);
+  if (t < 6) return 3000;
+  if (t < 6.5) return 3000 * (6.5 - t) / 0.5;
+  return 0;
+}
+
+// poll the simulated MCS12085 over the speed profile, in virtual time,
+// with a fixed interval (poll == NULL) or an adaptive one
+static void poll_profile(const char *what, uint32_t fixed_us, AdaptivePoll *poll)
+{
+  SimBus &bus = sim_bus();
+  MCS12085Fast<MOUSE_SCLK, MOUSE_SDIO> mouse;
+  mouse.init();
+  SimMCS12085 chip(bus, MOUSE_SCLK, MOUSE_SDIO);
+
+  uint64_t t_end = bus.now() + 8000000000ULL;
+  uint64_t t_start = bus.now();
+  uint64_t busy = 0;
+  uint32_t interval = poll ? poll->interval() : fixed_us;
+  int samples = 0, saturated = 0;
+  long sx = 0;
+
+  while (bus.now() < t_end) {
+    hal_delay_us(interval);
+    chip.motion.setVelocity(speed_profile(bus.now() - t_start), 0, bus.now());
+    uint64_t t0 = bus.now();
+    MCS12085::Delta d = mouse.read_xy();
+    busy += bus.now() - t0;
+    ++samples;
+    sx += d.dx;
+    if (saturation_flags(d.dx, d.dy)) ++saturated;
+    if (poll) interval = poll->update(d.dx, d.dy);
+  }
+
+  printf("%-10s %5d samples, bus %6.1f ms, %4d saturated, read %ld of %ld counts (%.1f%% lost)\n",
+         what, samples, busy / 1e6, saturated, sx, chip.motion.true_x,
+         100.0 * (chip.motion.true_x - sx) / chip.motion.true_x);
+}
+
+static int run_adaptive(int)
+{
+  poll_profile("fixed 30ms", 30000, NULL);
+  poll_profile("fixed 5ms", 5000, NULL);
+  AdaptivePoll poll(1000, 50000);
+  poll_profile("adaptive", 0, &poll);
+  printf("           adaptive: %u idle, %u saturated, %u saturated at min interval\n",
+         poll.idle, poll.saturated, poll.saturated_at_min);
+  return 0;
+}
+
+// ADNS5020 sampled every 2 ms over the speed profile at a fixed or
+// automatic resolution; x is kept in 1000 CPI units either way
+static void cpi_profile(const char *what, int cpi, bool automatic)
+{
+  SimBus &bus = sim_bus();
+  SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+  ADNS5020 cam(CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET, cpi);
+  cam.reset();
+  cam.autoResolution(automatic);
+
+  uint64_t t_start = bus.now();
+  double mm0 = chip.motion.true_mm_x;
+  int saturated = 0;
+  while (bus.now() - t_start < 8000000000ULL) {
+    hal_delay_ms(2);
+    chip.motion.setVelocity(speed_profile(bus.now() - t_start) * 2 / 3, 0, bus.now());
+    cam.readBurst();
+    if (saturation_flags(cam.dx, cam.dy)) ++saturated;
+  }
+
+  double mm = cam.x * 25.4 / 1000;
+  double true_mm = chip.motion.true_mm_x - mm0;
+  printf("%-10s %4d saturated, %3u CPI switches, %3u CONTROL writes, %7.1f of %7.1f mm (%.2f%% error)\n",
+         what, saturated, cam.cpi_switches, chip.control_writes, mm, true_mm,
+         100.0 * (mm - true_mm) / true_mm);
+}
+
+static int run_cpi(int)
+{
+  cpi_profile("1000 CPI", 1000, false);
+  cpi_profile("500 CPI", 500, false);
+  cpi_profile("auto CPI", 1000, true);
+  return 0;
+}
+
+// I2C time for n framebuffer bytes at 400 kHz: 9 bits per byte plus one
+// address/control byte per 64 byte transaction, six single-byte command
+// transactions per page span
+static double i2c_us(int bytes, int spans)
+{
+  int wire = bytes + 2 * ((bytes + 63) / 64) + spans * 6 * 3;
+  return wire * 9 / 0.4;
+}
+
+// a status screen update where only the distance digits change, flushed
+// in full and differentially
+static int run_framediff(int samples)
+{
+  static uint8_t frame[OLED_BUFFER_SIZE], shown[OLED_BUFFER_SIZE];
+  lcg = 1;
+  for (int i = 0; i < OLED_BUFFER_SIZE; ++i)
+    frame[i] = (i % OLED_WIDTH < 100 && (i / OLED_WIDTH) % 3 != 2) ? (rand_delta(127) & 0xff) : 0;
+  memcpy(shown, frame, sizeof(frame));
+
+  PageSpan spans[OLED_PAGES];
+  long bytes = 0, nspans = 0;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < samples; ++i) {
+    // distance field: page 5, columns 90..127
+    for (int c = 90 + (i % 4) * 6; c < 96 + (i % 4) * 6; ++c)
+      frame[5 * OLED_WIDTH + c] ^= 0x3c;
+    bytes += frame_diff(frame, shown, spans);
+    for (int p = 0; p < OLED_PAGES; ++p) nspans += !spans[p].empty();
+  }
+  double ns = elapsed_ns(t0, samples);
+
+  printf("framediff  full flush %d bytes, %.0f us I2C\n", OLED_BUFFER_SIZE, i2c_us(OLED_BUFFER_SIZE, OLED_PAGES));
+  printf("           diff flush %.1f bytes in %.1f spans, %.0f us I2C, diff %.0f ns\n",
+         (double)bytes / samples, (double)nspans / samples,
+         i2c_us(bytes / samples, nspans / samples), ns);
+  return 0;
+}
+
+// stand-in for the OLED: a full I2C frame takes about 27 ms, and every
+// snapshot must arrive whole (location encodes the distance)
+static uint32_t torn = 0;
+static void render_slow(void *, const StatusSnapshot &s)
+{
+  char expect[sizeof(s.location)];
+  snprintf(expect, sizeof(expect), "%ld", s.distance_mm);
+  if (strcmp(expect, s.location) != 0) ++torn;
+  std::this_thread::sleep_for(std::chrono::milliseconds(27));
+}
+
+// the control loop posts snapshots at 1 kHz while the display task renders
+// at 5 Hz; the post must never wait for a frame
+static int run_display(int samples)
+{
+  using namespace std::chrono;
+  DisplayService service(render_slow, NULL, 200);
+  service.start();
+
+  StatusSnapshot s;
+  strcpy(s.vehicle, "IMOB-A");
+  strcpy(s.ip, "0.0.0.0");
+  strcpy(s.destination, "YELLOW");
+  double max_post_ns = 0;
+  steady_clock::time_point wake = steady_clock::now();
+  for (int i = 0; i < samples; ++i) {
+    s.distance_mm = i;
+    snprintf(s.location, sizeof(s.location), "%d", i);
+    steady_clock::time_point t0 = steady_clock::now();
+    service.post(s);
+    double ns = elapsed_ns(t0, 1);
+    if (ns > max_post_ns) max_post_ns = ns;
+    wake += microseconds(1000);
+    std::this_thread::sleep_until(wake);
+  }
+  service.stop();
+
+  printf("display    %d posted, %u frames, %u dropped, %u torn, frame %u us (max %u), post max %.0f ns\n",
+         samples, service.frames, service.dropped(), torn, service.last_frame_us,
+         service.max_frame_us, max_post_ns);
+  return torn == 0 ? 0 : 1;
+}
+
+// 10k tags with 4, 7 and 10 byte UIDs: hashed lookups against the old
+// linear scan, for tags in the table and unknown ones
+static int run_tags(int samples)
+{
+  static TagTable<16384> table;
+  const int count = 10000;
+  static uint8_t uids[2 * count][TAG_UID_MAX];
+  static uint8_t sizes[2 * count];
+  char line[96], hex[2 * TAG_UID_MAX + 1];
+
+  lcg = 7;
+  table.clear();
+  for (int i = 0; i < 2 * count; ++i) {
+    sizes[i] = (i % 3 == 0) ? 4 : (i % 3 == 1 ? 7 : 10);
+    for (int k = 0; k < sizes[i]; ++k) uids[i][k] = rand_delta(127) & 0xff;
+    if (i >= count) continue;   // second half: not in the table
+    TagRegistry::formatUid(uids[i], sizes[i], hex, sizeof(hex));
+    snprintf(line, sizeof(line), "%s T%d %d %d T%d T%d", hex, i, i * 10, i * 20,
+             (i + 1) % count, (i + count - 1) % count);
+    table.addLine(line);
+  }
+  for (int i = 0; i < count; ++i) {
+    TagRegistry::formatUid(uids[i], sizes[i], hex, sizeof(hex));
+    snprintf(line, sizeof(line), "%s T%d %d %d T%d T%d", hex, i, i * 10, i * 20,
+             (i + 1) % count, (i + count - 1) % count);
+    table.linkLine(line);
+  }
+
+  // correctness: every tag is found with its record, unknown ones are not
+  int errors = 0;
+  for (int i = 0; i < 2 * count; ++i) {
+    const TagRecord *t = table.find(uids[i], sizes[i]);
+    if (i < count) {
+      snprintf(line, sizeof(line), "T%d", i);
+      if (!t || strcmp(t->name, line) != 0 || t->num_neighbors != 2 ||
+          table.findName(line) != t || t->y_mm != i * 20)
+        ++errors;
+    } else if (t) {
+      ++errors;
+    }
+  }
+
+  volatile uint32_t sink = 0;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < samples; ++i) {
+    int k = (unsigned)i * 7919u % (2 * count);
+    sink += table.find(uids[k], sizes[k]) != NULL;
+  }
+  double hashed = elapsed_ns(t0, samples);
+
+  // the old uid_to_color() scan over the same records
+  int scans = samples / 100 + 1;
+  t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < scans; ++i) {
+    int k = (unsigned)i * 7919u % (2 * count);
+    for (int r = 0; r < table.size(); ++r)
+      if (table[r].uid_size == sizes[k] && memcmp(table[r].uid, uids[k], sizes[k]) == 0) {
+        ++sink;
+        break;
+      }
+  }
+  double linear = elapsed_ns(t0, scans);
+
+  printf("tags       %d tags, %u bytes, max probe %u, lookup %.0f ns, linear scan %.0f ns, %d errors\n",
+         table.size(), (unsigned)sizeof(table), table.maxProbe(), hashed, linear, errors);
+  return errors == 0 ? 0 : 1;
+}
+
+// task bodies for the scheduler run: burn their cost on the virtual clock
+static void busy_task(void *cost_us)
+{
+  hal_delay_us((uint32_t)(uintptr_t)cost_us);
+}
+
+// the loop() task set on the virtual clock, plus tag events at random
+// times; same output on every run. Halfway an event task without a
+// deadline joins, the tasks already running keep their statistics.
+static int run_sched(int samples)
+{
+  Scheduler sched;
+  sched.add("rfid", busy_task, (void *)300, 5000, 0, 2);
+  int odometry = sched.add("odometry", busy_task, (void *)800, 20000, 0, 1);
+  sched.add("display", busy_task, (void *)3000, 200000);
+  sched.add("telemetry", busy_task, (void *)1500, 100000, 50000);
+  int tag = sched.add("tag", busy_task, (void *)1200, 0, 4000, 3);
+  int report = -1;
+
+  lcg = 3;
+  uint32_t start = hal_micros();
+  uint32_t end = start + (uint32_t)samples * 1000;
+  uint32_t next_tag = hal_micros() + 50000;
+  while ((int32_t)(end - hal_micros()) > 0) {
+    if (report < 0 && hal_micros() - start >= (uint32_t)samples * 500)
+      report = sched.add("report", busy_task, (void *)2000, 0);
+    if ((int32_t)(hal_micros() - next_tag) >= 0) {
+      sched.signal(tag);
+      sched.signal(odometry);
+      if (report >= 0) sched.signal(report);
+      next_tag += 50000 + rand_delta(40000);
+    }
+    if (!sched.runOnce()) {
+      uint32_t wait = sched.idle();
+      uint32_t to_tag = next_tag - hal_micros();
+      hal_delay_us(wait < to_tag ? wait : to_tag);
+    }
+  }
+
+  printf("sched      %d ms virtual time\n", samples);
+  for (int i = 0; i < sched.count(); ++i) {
+    const Scheduler::Task &t = sched.task(i);
+    printf("  %-10s %6u runs, %4u missed, %4u skipped, jitter max %5u us, exec max %5u us avg %5.0f us\n",
+           t.name, t.runs, t.missed, t.skipped, t.max_jitter_us, t.max_exec_us,
+           t.runs ? (double)t.total_exec_us / t.runs : 0.0);
+  }
+  bool ok = sched.task(0).runs + 2 >= (uint32_t)samples * 1000 / 5000 &&
+            sched.task(report).runs > 0 && sched.task(report).missed == 0;
+  return ok ? 0 : 1;
+}
+
+// stages registered by two threads at once, placed in static storage
+#define PROF_RACE_STAGES 1000
+static std::aligned_storage<sizeof(ProfStage), alignof(ProfStage)>::type
+  prof_race[2][PROF_RACE_STAGES];
+static std::atomic<bool> prof_go;
+
+static void prof_register(int thread)
+{
+  while (!prof_go.load()) {}
+  for (int i = 0; i < PROF_RACE_STAGES; ++i) new (&prof_race[thread][i]) ProfStage("race");
+}
+
+// stage histograms for the fast mouse read and the odometer, the cost of
+// a scope that times nothing, and stages registering concurrently
+static int run_profile(int samples)
+{
+  SimBus &bus = sim_bus();
+  MCS12085Fast<MOUSE_SCLK, MOUSE_SDIO> mouse;
+  mouse.init();
+  SimMCS12085 chip(bus, MOUSE_SCLK, MOUSE_SDIO);
+  chip.motion.setVelocity(300, 100, bus.now());
+  Odometer odo(20000);
+
+  profiler_reset();
+  for (int i = 0; i < samples; ++i) {
+    MCS12085::Delta d;
+    {
+      PROFILE_SCOPE("mouse read");
+      d = mouse.read_xy();
+    }
+    {
+      PROFILE_SCOPE("odometer");
+      odo.add(d.dx, d.dy);
+    }
+    hal_delay_us(1000);
+  }
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < samples; ++i) {
+    PROFILE_SCOPE("empty");
+  }
+  double scope = elapsed_ns(t0, samples);
+
+  profiler_dump();
+  printf("profile    scope overhead %.0f ns\n", scope);
+
+  // two threads registering stages at the same time, as the sampler task
+  // and loop() can on their first PROFILE_SCOPE; the list is restored after
+  ProfStage *head = ProfStage::first;
+  prof_go = false;
+  std::thread a(prof_register, 0), b(prof_register, 1);
+  prof_go = true;
+  a.join();
+  b.join();
+  int listed = 0;
+  for (ProfStage *s = ProfStage::first; s != head; s = s->next) ++listed;
+  ProfStage::first = head;
+  printf("           %d of %d stages registered from two threads\n", listed, 2 * PROF_RACE_STAGES);
+  return listed == 2 * PROF_RACE_STAGES ? 0 : 1;
+}
+
+// ADNS5020 readings as binary telemetry on stdout, with every 50th
+// sample a full pixel frame; sizes against the text output on stderr.
+//   program telemetry 1000 > capture.bin
+static int run_telemetry(int samples)
+{
+  SimBus &bus = sim_bus();
+  SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+  ADNS5020 cam(CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET, 1000);
+  cam.reset();
+  chip.motion.setVelocity(40, -10, bus.now());
+
+  TelemetryWriter tlm;
+  char text[600];
+  long text_bytes = 0;
+  int frames = 0;
+  for (int i = 0; i < samples; ++i) {
+    hal_delay_ms(10);
+    if (i % 50 == 49) {
+      cam.mousecamTelemetry(tlm);
+      // mousecamOutput(): DELTA line, FRAME: and two hex digits per pixel
+      text_bytes += snprintf(text, sizeof(text), "DELTA:%d %d\r\nFRAME:", cam.dx, cam.dy)
+                    + 2 * ADNS5020_FRAME_LENGTH + 2;
+      ++frames;
+      continue;
+    }
+    cam.readBurst();
+    cam.writeAll(tlm, hal_micros());
+    // printAll(): " DX:" and a 4 character number per field
+    text_bytes += 7 * 8 + 2;
+  }
+  tlm.flush();
+
+  double bin = (double)tlm.bytes / samples, txt = (double)text_bytes / samples;
+  fprintf(stderr, "telemetry  %d records (%d frames), binary %u bytes (%.1f/record), text %ld bytes (%.1f/record)\n",
+          samples, frames, tlm.bytes, bin, text_bytes, txt);
+  fprintf(stderr, "           at 115200 baud: %.0f records/s binary, %.0f records/s text\n",
+          11520 / bin, 11520 / txt);
+  return 0;
+}
+
+// surface images: ADNS5020Fast captures on its own thread into the frame
+// pipe, this thread encodes and frames them; a synthetic floor texture
+// (smooth shading, fine grain) stands in for the real surface
+static int run_frames(int samples)
+{
+  SimBus &bus = sim_bus();
+  SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+  typedef ADNS5020Fast<CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET> Cam;
+  Cam cam;
+  cam.init(1000);
+
+  lcg = 5;
+  for (int i = 0; i < FRAME_PIXELS; ++i) {
+    int r = i / FRAME_SIDE, c = i % FRAME_SIDE;
+    chip.pixels[i] = (40 + 2 * r + c + ((rand_delta(8) > 6) ? 3 : 0)) & 0x7f;
+  }
+
+  FramePipe pipe;
+  volatile bool capturing = true;
+  uint64_t t_start = bus.now();
+  uint64_t t_end = t_start;
+  std::thread capture([&]() {
+    for (int i = 0; i < samples; ++i) {
+      PixelFrame *f = pipe.acquire();
+      if (!f) {
+        std::this_thread::yield();
+        --i;
+        continue;
+      }
+      f->t_us = hal_micros();
+      if (cam.grabFrame(f->pixels)) pipe.publish(f);
+      else pipe.discard(f);
+    }
+    t_end = bus.now();
+    capturing = false;
+  });
+
+  TelemetryWriter tlm;
+  uint8_t enc[FRAME_PIXELS], check[FRAME_PIXELS];
+  long enc_bytes = 0;
+  uint32_t sent = 0, errors = 0;
+  while (capturing || pipe.captured > sent + pipe.failed) {
+    PixelFrame *f = pipe.next();
+    if (!f) {
+      std::this_thread::yield();
+      continue;
+    }
+    int n = frame_encode(f->pixels, enc);
+    if (!frame_decode(enc, n, check) || memcmp(check, f->pixels, FRAME_PIXELS) != 0) ++errors;
+    tlm.begin(TLM_FRAME_RLE, f->t_us);
+    tlm.putUnsigned(f->seq);
+    tlm.putBytes(enc, n);
+    tlm.end();
+    tlm.clear();
+    enc_bytes += n;
+    ++sent;
+    pipe.release(f);
+  }
+  capture.join();
+
+  double secs = (t_end - t_start) / 1e9;
+  printf("frames     %u captured, %u failed, %.1f frames/s (sim bus time), %u violations\n",
+         pipe.captured, pipe.failed, pipe.captured / secs, chip.violations);
+  printf("           %d bytes raw, %.1f encoded, %.1f per telemetry frame, %u round trip errors\n",
+         FRAME_PIXELS, (double)enc_bytes / sent, (double)tlm.bytes / sent, errors);
+  return errors == 0 && pipe.failed == 0 ? 0 : 1;
+}
+
+// odometry and logging written once against FlowSensor, instantiated for
+// each sensor model; distances compared with the simulated ground truth
+template <class Sensor>
+static double track(const char *name, FlowSensor<Sensor> &sensor, SimMotion &motion,
+                    uint32_t counts_per_m, int samples)
+{
+  Odometer odo(counts_per_m);
+  TelemetryWriter tlm;
+  MotionSample s;
+  uint32_t saturated = 0;
+  for (int i = 0; i < samples; ++i) {
+    hal_delay_ms(5);
+    if (!sensor.sample(s)) continue;
+    odo.add(s.dx, s.dy);
+    saturated += (s.flags & (SAMPLE_SAT_X | SAMPLE_SAT_Y)) != 0;
+    tlm.writeSample(s);
+    tlm.clear();
+  }
+  double truth = hypot(motion.true_mm_x, motion.true_mm_y);
+  printf("  %-14s %8.1f mm, true %8.1f mm, %u saturated, %.1f telemetry bytes/sample\n",
+         name, (double)odo.mm(), truth, saturated, (double)tlm.bytes / samples);
+  return fabs(odo.mm() - truth) / truth;     // relative error
+}
+
+static int run_sensors(int samples)
+{
+  SimBus &bus = sim_bus();
+  printf("sensors    %d samples each, 5 ms apart\n", samples);
+  {
+    MCS12085Fast<MOUSE_SCLK, MOUSE_SDIO> mouse;
+    mouse.init();
+    SimMCS12085 chip(bus, MOUSE_SCLK, MOUSE_SDIO);
+    chip.motion.setVelocity(300, 100, bus.now());
+    track("mcs12085fast", mouse, chip.motion, 20000, samples);
+  }
+  {
+    SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+    ADNS5020 cam(CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET, 1000);
+    cam.reset();
+    cam.autoResolution(true);
+    chip.motion.setVelocity(300, 100, bus.now());
+    track("adns5020", cam, chip.motion, 39370, samples);
+  }
+  {
+    // 600 and 100 mm/s in turns of 0.5 s: the camera switches CPI both ways
+    SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+    ADNS5020 cam(CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET, 1000);
+    cam.reset();
+    cam.autoResolution(true);
+    Odometer odo(39370);
+    MotionSample s;
+    for (int i = 0; i < samples; ++i) {
+      if (i % 100 == 0)
+        chip.motion.setVelocity((i / 100) & 1 ? 100 : 600, 0, bus.now());
+      hal_delay_ms(5);
+      if (cam.sample(s)) odo.add(s.dx, s.dy);
+    }
+    double truth = hypot(chip.motion.true_mm_x, chip.motion.true_mm_y);
+    double err = fabs(odo.mm() - truth);
+    printf("  %-14s %8.1f mm, true %8.1f mm, %u CPI switches\n",
+           "adns5020 vary", (double)odo.mm(), truth, cam.cpi_switches);
+    if (cam.cpi_switches < 2 || err > 0.005 * truth + 1) return 1;
+  }
+  {
+    SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+    ADNS5020Fast<CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET> cam;
+    cam.init(1000);
+    chip.motion.setVelocity(300, 100, bus.now());
+    track("adns5020fast", cam, chip.motion, 39370, samples);
+  }
+  {
+    // samples stay in 1000 CPI counts at 500 CPI
+    SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+    ADNS5020Fast<CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET> cam;
+    cam.init(500);
+    chip.motion.setVelocity(300, 100, bus.now());
+    if (track("fast 500 CPI", cam, chip.motion, 39370, samples) > 0.005) return 1;
+  }
+  return 0;
+}
+
+// two ADNS5020 at 1000 CPI, 80 mm left and right of the center, the right
+// one mounted turned around; one row per sensor and 20 ms batch
+#define FUSION_BATCH_MS 20
+#define FUSION_MAX_TRACE 65536
+
+struct TraceRow {
+  int batch;
+  int sensor;
+  MotionSample s;
+};
+
+static TraceRow trace[FUSION_MAX_TRACE];
+
+static const FlowMount fusion_mounts[] = {
+  { 0,  80, 0,             25.4f, 1, 20 },
+  { 0, -80, (float)M_PI,   25.4f, 1, 20 },
+};
+
+static FlowFusion *fusion_setup(FlowFusion &f)
+{
+  for (unsigned i = 0; i < sizeof(fusion_mounts) / sizeof(fusion_mounts[0]); ++i)
+    f.addSensor(fusion_mounts[i]);
+  return &f;
+}
+
+// feeds a trace through a fusion into a pose, batch by batch
+static void fusion_run(FlowFusion &f, PoseTracker &pose, const TraceRow *rows, int n)
+{
+  FlowMotion m;
+  for (int i = 0; i < n; ++i) {
+    f.add(rows[i].sensor, rows[i].s);
+    if ((i + 1 == n || rows[i + 1].batch != rows[i].batch) && f.solve(m))
+      pose.update(m, rows[i].s.t_us + FUSION_BATCH_MS * 1000);
+  }
+}
+
+// returns the position error in mm
+static double fusion_report(const char *name, const Pose &p, double x_mm, double y_mm,
+                            double heading_deg)
+{
+  double dh = FUSION_DEG(p.heading) - heading_deg;
+  dh -= 360 * floor((dh + 180) / 360);
+  double e = hypot(p.x_um / 1000.0 - x_mm, p.y_um / 1000.0 - y_mm);
+  printf("  %-16s heading %7.2f deg (error %6.2f), position error %6.1f mm, path %7.1f mm\n",
+         name, FUSION_DEG(p.heading), dh, e, p.path_um / 1000.0);
+  return e;
+}
+
+// a drive with turns, sensor 1 over a glossy patch (60% of the counts,
+// sideways jitter, squal 25) and sensor 0 lifted over a bump (squal 5)
+// for a while. Two sensors side by side can't tell the short forward
+// counts of the patch from a turn, only the jitter across is caught.
+static int run_fusion(int batches, const char *path)
+{
+  if (batches * 2 > FUSION_MAX_TRACE) batches = FUSION_MAX_TRACE / 2;
+  int slip = batches / 3, lift = 2 * batches / 3;
+  double x = 0, y = 0, theta = 0, dist = 0;
+  double rest[2][2] = { { 0, 0 }, { 0, 0 } };
+  int n = 0;
+  lcg = 1;
+
+  for (int b = 0; b < batches; ++b) {
+    double t = b * FUSION_BATCH_MS / 1000.0;
+    double v = 300 * FUSION_BATCH_MS / 1000.0;                                // mm
+    double w = 0.8 * sin(2 * M_PI * t / 8) * FUSION_BATCH_MS / 1000.0;      // rad
+    for (int i = 0; i < 2; ++i) {
+      const FlowMount &mt = fusion_mounts[i];
+      // floor motion under the sensor in the vehicle frame, then sensor frame
+      double vx = v - w * mt.y_mm, vy = w * mt.x_mm;
+      double c = cos(mt.angle), s = sin(mt.angle);
+      double sx = (c * vx + s * vy) / (mt.um_per_count / 1000.0);
+      double sy = (-s * vx + c * vy) / (mt.um_per_count / 1000.0);
+      uint8_t squal = 60 + rand_delta(10);
+      if (i == 1 && b >= slip && b < slip + 50) {
+        sx *= 0.6;
+        sy = sy * 0.6 + rand_delta(40);
+        squal = 25;
+      }
+      if (i == 0 && b >= lift && b < lift + 25) { sx = sy = 0; squal = 5; }
+      rest[i][0] += sx + rand_delta(1);
+      rest[i][1] += sy + rand_delta(1);
+      TraceRow &r = trace[n++];
+      r.batch = b;
+      r.sensor = i;
+      r.s.t_us = (uint32_t)(t * 1e6);
+      r.s.dx = (int16_t)lrint(rest[i][0]);
+      r.s.dy = (int16_t)lrint(rest[i][1]);
+      r.s.squal = squal;
+      r.s.flags = (r.s.dx || r.s.dy) ? SAMPLE_MOTION : 0;
+      rest[i][0] -= r.s.dx;
+      rest[i][1] -= r.s.dy;
+    }
+    x += v * cos(theta + w / 2);
+    y += v * sin(theta + w / 2);
+    theta += w;
+    dist += v;
+  }
+
+  if (path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+      fprintf(stderr, "can't open %s\n", path);
+      return 1;
+    }
+    fprintf(f, "# batch,sensor,t_us,dx,dy,squal,flags\n");
+    for (int i = 0; i < n; ++i)
+      fprintf(f, "%d,%d,%u,%d,%d,%u,%u\n", trace[i].batch, trace[i].sensor, trace[i].s.t_us,
+              trace[i].s.dx, trace[i].s.dy, trace[i].s.squal, trace[i].s.flags);
+    fclose(f);
+  }
+
+  double heading = theta * 180 / M_PI;
+  printf("fusion     %d batches of %d ms, true heading %.2f deg, path %.1f mm\n",
+         batches, FUSION_BATCH_MS, heading, dist);
+
+  FlowFusion fused;
+  PoseTracker pose;
+  fusion_run(*fusion_setup(fused), pose, trace, n);
+  double fused_e = fusion_report("fused", pose.pose(), x, y, heading);
+  printf("  %-16s %u rejected, %u low quality, %u saturated, %u batches without rotation\n", "",
+         fused.rejected, fused.low_quality, fused.saturated, fused.no_rotation);
+
+  // only the min_squal of the mounts
+  FlowFusion plain(1 << 30);
+  plain.squal_pct = 0;
+  plain.hold_ms = 0;
+  pose.reset();
+  fusion_run(*fusion_setup(plain), pose, trace, n);
+  double plain_e = fusion_report("plain", pose.pose(), x, y, heading);
+
+  FlowFusion single;
+  single.addSensor(fusion_mounts[0]);
+  TraceRow *rows = trace;
+  int m = 0;
+  for (int i = 0; i < n; ++i)
+    if (trace[i].sensor == 0) rows[m++] = trace[i];
+  pose.reset();
+  fusion_run(single, pose, rows, m);
+  fusion_report("sensor 0 only", pose.pose(), x, y, heading);
+
+  // a clipped sample: the only sensor keeps its counts, one of two is left out
+  MotionSample sat = { 0, 127, 0, 60, SAMPLE_MOTION | SAMPLE_SAT_X };
+  MotionSample fine = { 0, -150, 0, 60, SAMPLE_MOTION };   // sensor 1 is mounted reversed
+  FlowMotion fm;
+  FlowFusion one;
+  one.addSensor(fusion_mounts[0]);
+  one.add(0, sat);
+  bool one_ok = one.solve(fm) && fm.dx_um > 0;
+  FlowFusion two;
+  fusion_setup(two);
+  two.add(0, sat);
+  two.add(1, fine);
+  bool two_ok = two.solve(fm) && fm.sensors == 1 && two.saturated == 1;
+  printf("  %-16s one sensor %s, one of two %s\n", "saturated",
+         one_ok ? "kept" : "LOST", two_ok ? "left out" : "USED");
+
+  // solve() and update() cost, two sensors
+  int repeat = 1 + 200000 / batches;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < repeat; ++r) {
+    FlowFusion f;
+    pose.reset();
+    fusion_run(*fusion_setup(f), pose, trace, n);
+  }
+  printf("  %.1f ns per batch\n", elapsed_ns(t0, repeat * batches));
+  return fused_e < plain_e && one_ok && two_ok ? 0 : 1;
+}
+
+// one writer updating a pose as fast as it can, two readers checking every
+// copy they get is consistent (fwd and path both 1 mm per update). The
+// writer starts once both readers run and keeps going for at least 200 ms.
+static std::atomic<bool> pose_done;
+static std::atomic<int> pose_readers;
+static void pose_reader(const PoseTracker *tracker, uint32_t *reads, uint32_t *torn)
+{
+  Pose p;
+  ++pose_readers;
+  while (!pose_done.load()) {
+    if (!tracker->read(p)) continue;
+    ++*reads;
+    if (p.fwd_um != (int64_t)p.updates * 1000 || p.path_um != (uint64_t)p.updates * 1000) ++*torn;
+  }
+}
+
+// then a drive along a row of tags 1 m apart, started with the heading off
+// by 5 deg: position error at each tag, with and without fixes
+static int run_pose(int samples)
+{
+  PoseTracker tracker;
+  FlowMotion m = { 1000, 0, 0, 1, false };
+  uint32_t reads[2] = { 0, 0 }, torn[2] = { 0, 0 };
+  pose_done = false;
+  pose_readers = 0;
+  std::thread r0(pose_reader, &tracker, &reads[0], &torn[0]);
+  std::thread r1(pose_reader, &tracker, &reads[1], &torn[1]);
+  while (pose_readers.load() < 2) std::this_thread::yield();
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  int updates = 0;
+  while (updates < samples ||
+         std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(200)) {
+    for (int i = 0; i < 1000; ++i, ++updates) tracker.update(m, updates * 20);
+  }
+  double ns = elapsed_ns(t0, updates);
+  pose_done = true;
+  r0.join();
+  r1.join();
+  uint32_t total_reads = reads[0] + reads[1];
+  printf("pose       %d updates, %.1f ns each; %u reads, %u retries, %u torn\n",
+         updates, ns, total_reads, tracker.read_retries(), torn[0] + torn[1]);
+
+  uint32_t off = (uint32_t)(int32_t)(5 * M_PI / 180 * FUSION_BAM_PER_RAD);
+  for (int fixes = 0; fixes < 2; ++fixes) {
+    tracker.reset(0, 0, off);
+    tracker.fix(0, 0, 0);
+    double worst = 0, sum = 0;
+    uint32_t t = 0;
+    m.dx_um = 10000;      // 500 mm/s in 20 ms batches
+    for (int tag = 1; tag <= 10; ++tag) {
+      for (int b = 0; b < 100; ++b) tracker.update(m, t += 20000);
+      const Pose &p = tracker.pose();
+      double e = hypot(p.x_um / 1000.0 - 1000 * tag, p.y_um / 1000.0);
+      if (e > worst) worst = e;
+      sum += e;
+      if (fixes) tracker.fix(1000 * tag, 0, t);
+    }
+    const Pose &p = tracker.pose();
+    printf("  %-16s error at the tags avg %5.1f mm, max %5.1f mm, heading %5.2f deg, %u heading fixes\n",
+           fixes ? "tag fixes" : "no fixes", sum / 10, worst, FUSION_DEG(p.heading),
+           tracker.heading_fixes);
+  }
+
+  // telemetry round trip of the last pose
+  TelemetryWriter tlm;
+  TelemetryDecoder dec;
+  TelemetryRecord r;
+  const Pose &p = tracker.pose();
+  bool decoded = false;
+  tlm.writePose(p);
+  for (size_t i = 0; i < tlm.size(); ++i) decoded |= dec.push(tlm.data()[i], r);
+  bool ok = decoded && r.type == TLM_POSE && r.fields[0] == p.x_um / 1000 &&
+            r.fields[2] == (int32_t)floor(FUSION_DEG(p.heading) * 100);
+  printf("  pose telemetry   %u bytes, %s\n", (unsigned)tlm.size(), ok ? "decoded" : "MISMATCH");
+  // a run where the readers hardly overlapped the writer checks nothing
+  bool raced = total_reads >= 1000 && tracker.read_retries() > 0;
+  if (!raced) printf("  readers did not overlap the writer\n");
+  return torn[0] + torn[1] == 0 && ok && raced ? 0 : 1;
+}
+
+// power: the firmware's tasks on the scheduler, an ADNS5020 polled every
+// 5 ms when active and 50 ms when slow, light sleep when the scheduler is
+// idle in the sleep states. Currents are rough assumptions for the
+// estimate: ESP32 40 mA running, 0.8 mA light sleep; ADNS5020 10 mA, 0.01
+// mA powered down; MFRC522 30 mA with the field on, 3 mA off.
+#define POWER_ESP32_MA      40.0
+#define POWER_ESP32_SLEEP_MA 0.8
+#define POWER_ADNS_MA       10.0
+#define POWER_ADNS_PD_MA    0.01
+#define POWER_RFID_MA       30.0
+#define POWER_RFID_OFF_MA   3.0
+
+struct PowerBench {
+  ADNS5020 *cam;
+  Scheduler *sched;
+  PowerManager *power;
+  int sample_task;
+  int power_task;
+  WifiLink *wifi;             // NULL: no SSID
+  int link_task;
+  bool sleep_with_wifi;       // light sleep regardless, as loop() used to
+};
+
+static void power_apply(void *ctx, PowerState state)
+{
+  PowerBench &b = *static_cast<PowerBench *>(ctx);
+  switch (state) {
+    case POWER_ACTIVE: b.cam->wake(); b.sched->setPeriod(b.sample_task, 5000); break;
+    case POWER_SLOW:   b.sched->setPeriod(b.sample_task, 50000); break;
+    case POWER_SLEEP:  b.cam->sleep(); b.sched->setPeriod(b.sample_task, 0); break;
+    case POWER_PROBE:  b.cam->wake(); break;
+    default: break;
+  }
+}
+
+static bool power_check(void *ctx)
+{
+  PowerBench &b = *static_cast<PowerBench *>(ctx);
+  b.cam->readBurst();
+  return b.cam->dx || b.cam->dy;
+}
+
+static void power_sample_task(void *ctx)
+{
+  PowerBench &b = *static_cast<PowerBench *>(ctx);
+  b.cam->readBurst();
+  if (b.cam->dx || b.cam->dy) b.power->activity(hal_millis());
+}
+
+static void power_task(void *ctx)
+{
+  PowerBench &b = *static_cast<PowerBench *>(ctx);
+  b.sched->setPeriod(b.power_task, b.power->update(hal_millis()) * 1000);
+}
+
+static void power_link_wake(void *ctx)
+{
+  PowerBench &b = *static_cast<PowerBench *>(ctx);
+  b.sched->signal(b.link_task);
+}
+
+static void power_link_task(void *ctx)
+{
+  PowerBench &b = *static_cast<PowerBench *>(ctx);
+  b.sched->setPeriod(b.link_task, b.wifi->update(hal_millis()) * 1000);
+}
+
+struct PowerRun {
+  uint64_t sleep_us;
+  uint32_t max_latency;
+  uint32_t sum_latency;
+  uint32_t woken;
+};
+
+// drive at 300 mm/s or stand for ms, counting the time in light sleep and
+// how long a drive took to wake the vehicle
+static void power_phase(PowerBench &b, SimADNS5020 &chip, bool driving, uint32_t ms, PowerRun &r)
+{
+  SimBus &bus = sim_bus();
+  chip.motion.setVelocity(driving ? 300 : 0, 0, bus.now());
+  uint32_t t0 = hal_millis(), end = t0 + ms;
+  bool waiting = driving && b.power->state() != POWER_ACTIVE;
+  while ((int32_t)(hal_millis() - end) < 0) {
+    if (!b.sched->runOnce()) {
+      uint32_t idle = b.sched->idle();
+      uint32_t left = (end - hal_millis()) * 1000;
+      if (idle > left) idle = left;
+      bool link = b.wifi && b.wifi->state() != LINK_OFF;
+      if (b.power->asleep() && (!link || b.sleep_with_wifi)) {
+        // ESP-IDF keeps no station connection through light sleep
+        if (link) {
+          WifiLink::hostAccessPoint(false);
+          WifiLink::hostAccessPoint(true);
+        }
+        hal_light_sleep_us(idle);
+        r.sleep_us += idle;
+      } else {
+        hal_delay_us(idle);
+      }
+    }
+    if (waiting && b.power->state() == POWER_ACTIVE) {
+      uint32_t latency = hal_millis() - t0;
+      if (latency > r.max_latency) r.max_latency = latency;
+      r.sum_latency += latency;
+      ++r.woken;
+      waiting = false;
+    }
+  }
+}
+
+// cycles of driving 20 s at 300 mm/s and standing 100 s, then a stand of
+// 40 min, past the 2^31 us the scheduler clock can compare across, then
+// the cycles again with a WiFi link up
+static int run_power(int cycles)
+{
+  SimBus &bus = sim_bus();
+  SimADNS5020 chip(bus, CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET);
+  ADNS5020 cam(CAM_SCLK, CAM_SDIO, CAM_NCS, CAM_NRESET, 500);
+  cam.reset();
+
+  Scheduler sched;
+  PowerBench b = { &cam, &sched, NULL, 0, 0, NULL, 0, false };
+  PowerManager power(power_apply, power_check, &b, 2000, 10000, 250, 50);
+  b.power = &power;
+  b.sample_task = sched.add("sample", power_sample_task, &b, 5000, 0, 1);
+  b.power_task = sched.add("power", power_task, &b, 1000);
+
+  const uint32_t drive_ms = 20000, stand_ms = 100000, long_stand_ms = 40 * 60000;
+  uint32_t start_ms = hal_millis();
+  power.activity(start_ms);
+  PowerRun r = { 0, 0, 0, 0 };
+
+  for (int c = 0; c < cycles; ++c) {
+    power_phase(b, chip, true, drive_ms, r);
+    power_phase(b, chip, false, stand_ms, r);
+  }
+  uint64_t sleep_us = r.sleep_us;
+  uint32_t max_latency = r.max_latency, sum_latency = r.sum_latency, woken = r.woken;
+  const Scheduler::Task &t = sched.task(b.sample_task);
+  uint32_t cycle_skipped = t.skipped;   // a wake must not catch up on the stand
+
+  double total = hal_millis() - start_ms;
+  double awake = 1 - sleep_us / 1000.0 / total;
+  double sensor_off = power.state_ms[POWER_SLEEP] / total;
+  double field_off = (power.state_ms[POWER_SLEEP] + power.state_ms[POWER_PROBE]) / total;
+  double ma = POWER_ESP32_MA * awake + POWER_ESP32_SLEEP_MA * (1 - awake)
+            + POWER_ADNS_MA * (1 - sensor_off) + POWER_ADNS_PD_MA * sensor_off
+            + POWER_RFID_MA * (1 - field_off) + POWER_RFID_OFF_MA * field_off;
+  double always_on = POWER_ESP32_MA + POWER_ADNS_MA + POWER_RFID_MA;
+
+  printf("power      %d cycles of %u s driving, %u s standing (%.0f s)\n",
+         cycles, drive_ms / 1000, stand_ms / 1000, total / 1000);
+  printf("           ");
+  for (int i = 0; i < POWER_STATES; ++i)
+    printf("%s %.1f%%  ", power_state_name((PowerState)i), 100.0 * power.state_ms[i] / total);
+  printf("\n           CPU awake %.1f%%, %u checks, %u wakeups, wake latency avg %.0f ms, max %u ms\n",
+         100 * awake, power.checks, power.wakeups, woken ? (double)sum_latency / woken : 0.0,
+         max_latency);
+  printf("           est. %.1f mA against %.1f mA always on: %.1fx battery life, %u violations\n",
+         ma, always_on, always_on / ma, chip.violations);
+  printf("           sample task: %u runs, %u releases skipped\n", t.runs, cycle_skipped);
+
+  // the sample task must be back on its 5 ms period right after the wake
+  PowerRun lr = { 0, 0, 0, 0 };
+  power_phase(b, chip, false, long_stand_ms, lr);
+  uint32_t runs = t.runs, skipped = t.skipped;
+  power_phase(b, chip, true, drive_ms, lr);
+  runs = t.runs - runs;
+  skipped = t.skipped - skipped;
+  uint32_t expected = (drive_ms - lr.max_latency) / 5;
+  printf("           after a %u min stand: wake latency %u ms, %u samples in %u s (%u expected), %u skipped\n",
+         long_stand_ms / 60000, lr.max_latency, runs, drive_ms / 1000, expected, skipped);
+
+  // the same cycles with a WiFi link: the way loop() does it, delay()
+  // while the link is not off, then light sleep anyway
+  WifiLink link("bench", "", 2000);
+  b.wifi = &link;
+  b.link_task = sched.add("link", power_link_task, &b, 0);
+  link.notify(power_link_wake, &b);
+  link.begin(hal_millis());
+  sched.signal(b.link_task);
+  uint32_t wifi_drops = 0;
+  for (int mode = 0; mode < 2; ++mode) {
+    b.sleep_with_wifi = mode == 1;
+    PowerRun wr = { 0, 0, 0, 0 };
+    uint32_t drops = link.disconnects, up = link.up_ms, t0 = hal_millis();
+    for (int c = 0; c < cycles; ++c) {
+      power_phase(b, chip, true, drive_ms, wr);
+      power_phase(b, chip, false, stand_ms, wr);
+    }
+    double span = hal_millis() - t0;
+    drops = link.disconnects - drops;
+    double awake_w = 1 - wr.sleep_us / 1000.0 / span;
+    printf("           WiFi, %-20s %u disconnects, link up %.1f%%, CPU awake %.1f%% (ESP32 %.1f mA)\n",
+           mode ? "light sleep anyway:" : "delay() while linked:", drops,
+           100 * (link.up_ms - up) / span, 100 * awake_w,
+           POWER_ESP32_MA * awake_w + POWER_ESP32_SLEEP_MA * (1 - awake_w));
+    if (!mode) wifi_drops = drops;
+  }
+
+  uint32_t limit = power.check_ms + power.probe_ms + 10;
+  bool ok = max_latency <= limit && lr.max_latency <= limit && cycle_skipped <= 10u * cycles &&
+            runs + 10 >= expected && skipped <= 10 && wifi_drops == 0;
+  return ok ? 0 : 1;
+}
+
+// the startup units of main.cpp on the virtual clock: the waits are the
+// same, the work in the steps is modeled as busy time (the OLED init is a
+// full frame over 400 kHz I2C); the reader needs its retry and the access
+// point answers after wifi_ms
+#define BOOT_OLED_INIT_US 25000
+#define BOOT_WIFI_POLL_MS 500
+
+struct BootBench {
+  Scheduler *sched;
+  Startup *startup;
+  int startup_task;
+  int sample_task;
+  uint32_t begin_ms;
+  uint32_t first_sample_ms;
+  uint32_t wifi_ms;
+};
+
+static int32_t boot_oled(void *, uint16_t step)
+{
+  if (step == 0) return 50;
+  hal_delay_us(BOOT_OLED_INIT_US);
+  return STARTUP_DONE;
+}
+
+static int32_t boot_mouse(void *ctx, uint16_t step)
+{
+  BootBench &b = *static_cast<BootBench *>(ctx);
+  if (step == 0) return 100;
+  b.sched->setPeriod(b.sample_task, 5000);
+  return STARTUP_DONE;
+}
+
+static int32_t boot_rfid(void *, uint16_t step)
+{
+  switch (step) {
+    case 0: return 30;
+    case 1: return 100;   // no answer from the first PCD_Init()
+    default: return STARTUP_DONE;
+  }
+}
+
+static int32_t boot_wifi(void *ctx, uint16_t step)
+{
+  BootBench &b = *static_cast<BootBench *>(ctx);
+  if (hal_millis() - b.begin_ms >= b.wifi_ms && step > 0) return STARTUP_DONE;
+  return step >= 20 ? STARTUP_FAILED : BOOT_WIFI_POLL_MS;
+}
+
+static void boot_sample_task(void *ctx)
+{
+  BootBench &b = *static_cast<BootBench *>(ctx);
+  if (b.first_sample_ms == 0) b.first_sample_ms = hal_millis() - b.begin_ms;
+}
+
+static void boot_startup_task(void *ctx)
+{
+  BootBench &b = *static_cast<BootBench *>(ctx);
+  b.sched->setPeriod(b.startup_task, b.startup->run(hal_millis()) * 1000);
+}
+
+// staged startup against the serialized setup() it replaces
+static int run_startup(int wifi_ms)
+{
+  Scheduler sched;
+  Startup startup;
+  BootBench b = { &sched, &startup, 0, 0, (uint32_t)hal_millis(), 0, (uint32_t)wifi_ms };
+  b.sample_task = sched.add("sample", boot_sample_task, &b, 0, 0, 1);
+  b.startup_task = sched.add("startup", boot_startup_task, &b, 0);
+  startup.add("oled", boot_oled, &b);
+  startup.add("mouse", boot_mouse, &b);
+  startup.add("rfid", boot_rfid, &b);
+  startup.add("wifi", boot_wifi, &b);
+  sched.signal(b.startup_task);
+
+  while (!startup.finished() || b.first_sample_ms == 0) {
+    if (!sched.runOnce()) hal_delay_us(sched.idle());
+  }
+
+  // setup() before: 100 after Serial.begin(), the OLED reset and init, the
+  // mouse, the reader with its retry, then WiFi polled to the end
+  uint32_t serial_ready[4];
+  serial_ready[0] = 100 + 50 + BOOT_OLED_INIT_US / 1000;
+  serial_ready[1] = serial_ready[0] + 100;
+  serial_ready[2] = serial_ready[1] + 30 + 100;
+  uint32_t polls = (wifi_ms + BOOT_WIFI_POLL_MS - 1) / BOOT_WIFI_POLL_MS;
+  if (polls > 20) polls = 20;
+  serial_ready[3] = serial_ready[2] + polls * BOOT_WIFI_POLL_MS;
+  uint32_t serial_first = serial_ready[2];    // loop() drains the first samples, WiFi was left out
+
+  printf("startup    access point answers after %d ms\n", wifi_ms);
+  for (int i = 0; i < startup.count(); ++i) {
+    const Startup::Unit &u = startup.unit(i);
+    printf("           %-6s %-7s at %5u ms, serialized %5u ms\n", u.name,
+           startup_state_name(u.state), u.ready_ms - b.begin_ms, serial_ready[i]);
+  }
+  uint32_t staged = 0;
+  for (int i = 0; i < startup.count(); ++i)
+    if (startup.unit(i).ready_ms - b.begin_ms > staged) staged = startup.unit(i).ready_ms - b.begin_ms;
+  printf("           first sample at %u ms, serialized %u ms; all up at %u ms, serialized %u ms\n",
+         b.first_sample_ms, serial_first, staged, serial_ready[3]);
+  return b.first_sample_ms < serial_first && staged <= serial_ready[3] ? 0 : 1;
+}
+
+// the fleet dashboard's end: a UDP listener on the loopback interface,
+// decoding what arrives in real time
+struct UdpListener {
+  int sock;
+  uint16_t port;
+  std::atomic<bool> stop;
+  uint32_t datagrams;
+  uint32_t bytes;
+  uint32_t poses;
+  uint32_t tags;
+  uint32_t gaps;          // datagrams missing from the sequence
+  uint32_t last_dropped;  // as the sender counted
+  uint32_t crc_errors;
+};
+
+static void udp_listen(UdpListener *l)
+{
+  uint8_t buf[2048];
+  TelemetryDecoder dec;
+  TelemetryRecord r;
+  int32_t expect = 0;
+  while (!l->stop) {
+    ssize_t n = recv(l->sock, buf, sizeof(buf), 0);
+    if (n <= 0) continue;
+    ++l->datagrams;
+    l->bytes += n;
+    for (ssize_t i = 0; i < n; ++i) {
+      if (!dec.push(buf[i], r)) continue;
+      if (r.type == TLM_DATAGRAM) {
+        l->gaps += r.fields[0] - expect;
+        expect = r.fields[0] + 1;
+        l->last_dropped = r.fields[1];
+      }
+      if (r.type == TLM_POSE) ++l->poses;
+      if (r.type == TLM_TAG) ++l->tags;
+    }
+  }
+  l->crc_errors = dec.crc_errors;
+}
+
+struct UdpBench {
+  Scheduler *sched;
+  WifiLink *link;
+  UdpTelemetry *fleet;
+  int link_task;
+  uint32_t tag_ms;
+};
+
+// 50 Hz poses on a 2 m circle at 300 mm/s, a tag every 7 s
+static void udp_odometry_task(void *ctx)
+{
+  UdpBench &b = *static_cast<UdpBench *>(ctx);
+  uint32_t now = hal_millis();
+  float a = now * 0.3f / 1000 / 2;
+  Pose p = Pose();
+  p.t_us = hal_micros();
+  p.x_um = (int64_t)(2e6f * cosf(a));
+  p.y_um = (int64_t)(2e6f * sinf(a));
+  p.heading = (uint32_t)(int64_t)(a * FUSION_BAM_PER_RAD);
+  p.v_fwd_mm_s = 300;
+  p.omega_mrad_s = 150;
+  b.fleet->pose(p, now);
+  if (now - b.tag_ms >= 7000) {
+    b.tag_ms = now;
+    b.fleet->tag(p.t_us, "GREEN", p.x_um / 1000, p.y_um / 1000);
+  }
+}
+
+static void udp_link_wake(void *ctx)
+{
+  UdpBench &b = *static_cast<UdpBench *>(ctx);
+  b.sched->signal(b.link_task);
+}
+
+static void udp_link_task(void *ctx)
+{
+  UdpBench &b = *static_cast<UdpBench *>(ctx);
+  uint32_t now = hal_millis();
+  uint32_t wait = b.link->update(now);
+  uint32_t send = b.fleet->update(now);
+  if (send < wait) wait = send;
+  b.sched->setPeriod(b.link_task, wait * 1000);
+}
+
+// seconds of driving with the access point gone for 30 s after 100 s and
+// for 200 s after 300 s: the first outage fits the queue, the second not
+static int run_udp(int seconds)
+{
+  UdpListener l;
+  l.sock = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (l.sock < 0 || bind(l.sock, (struct sockaddr *)&addr, len) < 0 ||
+      getsockname(l.sock, (struct sockaddr *)&addr, &len) < 0) {
+    perror("udp listener");
+    return 1;
+  }
+  struct timeval tv = { 0, 100000 };
+  setsockopt(l.sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  l.port = ntohs(addr.sin_port);
+  l.stop = false;
+  l.datagrams = l.bytes = l.poses = l.tags = l.gaps = l.last_dropped = l.crc_errors = 0;
+  std::thread listener(udp_listen, &l);
+
+  Scheduler sched;
+  WifiLink link("bench", "");
+  UdpTelemetry fleet(link, "IMOB-A", 200, 1000);
+  UdpBench b = { &sched, &link, &fleet, 0, (uint32_t)hal_millis() };
+  sched.add("odometry", udp_odometry_task, &b, 20000, 0, 1);
+  b.link_task = sched.add("link", udp_link_task, &b, 0);
+  link.notify(udp_link_wake, &b);
+  fleet.begin("127.0.0.1", l.port);
+  uint32_t start = hal_millis();
+  link.begin(start);
+  sched.signal(b.link_task);
+
+  bool ap_up = true;
+  while (hal_millis() - start < (uint32_t)seconds * 1000) {
+    uint32_t t = (hal_millis() - start) / 1000;
+    bool ap = !(t >= 100 && t < 130) && !(t >= 300 && t < 500);
+    if (ap != ap_up) {
+      WifiLink::hostAccessPoint(ap);
+      ap_up = ap;
+    }
+    if (!sched.runOnce()) hal_delay_us(sched.idle());
+  }
+  WifiLink::hostAccessPoint(true);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  l.stop = true;
+  listener.join();
+  close(l.sock);
+
+  double total_s = (hal_millis() - start) / 1000.0;
+  printf("udp        %.0f s, %u records (%u poses coalesced), %u datagrams, %u sent, %u dropped, %u send errors\n",
+         total_s, fleet.records, fleet.coalesced, fleet.datagrams, fleet.sent, fleet.dropped, fleet.send_errors);
+  printf("           link: %u attempts, %u connects, %u disconnects, up %.1f%%\n",
+         link.attempts, link.connects, link.disconnects, 100.0 * link.up_ms / (total_s * 1000));
+  printf("           received %u datagrams, %u bytes (%.0f B/s, %.0f B/datagram), %u poses, %u tags\n",
+         l.datagrams, l.bytes, l.bytes / total_s, l.datagrams ? (double)l.bytes / l.datagrams : 0.0,
+         l.poses, l.tags);
+  printf("           %u gaps in the sequence (sender dropped %u), %u CRC errors\n",
+         l.gaps, l.last_dropped, l.crc_errors);
+  return l.datagrams == fleet.sent && l.gaps == l.last_dropped && l.crc_errors == 0 ? 0 : 1;
+}
+
+// a vehicle driving 60 s on a 2 m circle at 300 mm/s and standing 30 s,
+// a tag every 7 s while driving, reported over the simulated radio
+#define LORA_BENCH_SF 7
+#define LORA_BENCH_BW 125000
+#define LORA_BENCH_CR 5
+
+struct LoraBench {
+  Scheduler *sched;
+  LoraReporter *reporter;
+  SimRadio *radio;
+  FleetDecoder *decoder;
+  int lora_task;
+  Pose truth;
+  uint32_t start_ms;
+  uint32_t tag_ms;
+  float angle;
+  uint32_t received;
+  uint32_t tags;
+  double err_sum_cm;
+  double err_max_cm;
+};
+
+static void lora_odometry_task(void *ctx)
+{
+  LoraBench &b = *static_cast<LoraBench *>(ctx);
+  uint32_t now = hal_millis();
+  bool driving = (now - b.start_ms) % 90000 < 60000;
+  if (driving) b.angle += 0.3f * 0.02f / 2;
+  Pose &p = b.truth;
+  p.t_us = hal_micros();
+  p.x_um = (int64_t)(2e6f * cosf(b.angle));
+  p.y_um = (int64_t)(2e6f * sinf(b.angle));
+  p.heading = (uint32_t)(int64_t)((b.angle + (float)M_PI / 2) * FUSION_BAM_PER_RAD);
+  p.v_fwd_mm_s = driving ? 300 : 0;
+  b.reporter->pose(p);
+  if (driving && now - b.tag_ms >= 7000) {
+    b.tag_ms = now;
+    b.reporter->tag(p, (now / 7000) % 6, now);
+    b.sched->signal(b.lora_task);
+  }
+}
+
+static bool lora_sim_send(void *ctx, const uint8_t *data, uint8_t len)
+{
+  return static_cast<SimRadio *>(ctx)->send(data, len);
+}
+
+// the reporter, then the fleet side receiving what made it through
+static void lora_task(void *ctx)
+{
+  LoraBench &b = *static_cast<LoraBench *>(ctx);
+  b.sched->setPeriod(b.lora_task, b.reporter->update(hal_millis()) * 1000);
+
+  uint8_t frame[SIM_RADIO_PAYLOAD], len;
+  FleetReport r;
+  while (b.radio->receive(frame, len)) {
+    if (!b.decoder->decode(frame, len, r)) continue;
+    ++b.received;
+    if (r.kind == FLEET_TAG) {
+      ++b.tags;
+      continue;   // where the tag was, not where the vehicle is now
+    }
+    double ex = r.x_cm - b.truth.x_um / 1e4, ey = r.y_cm - b.truth.y_um / 1e4;
+    double e = sqrt(ex * ex + ey * ey);
+    b.err_sum_cm += e;
+    if (e > b.err_max_cm) b.err_max_cm = e;
+  }
+}
+
+static int run_lora(int minutes)
+{
+  SimRadio radio(sim_bus(), LORA_BENCH_SF, LORA_BENCH_BW, LORA_BENCH_CR);
+  radio.loss_permille = 100;
+  LoraParams params = { LORA_BENCH_SF, LORA_BENCH_BW, LORA_BENCH_CR, 8 };
+  LoraReporter reporter(lora_sim_send, &radio, 1, params, 9000, 2000, 2000);
+  FleetDecoder decoder;
+
+  Scheduler sched;
+  LoraBench b = LoraBench();
+  b.sched = &sched;
+  b.reporter = &reporter;
+  b.radio = &radio;
+  b.decoder = &decoder;
+  b.start_ms = b.tag_ms = hal_millis();
+  sched.add("odometry", lora_odometry_task, &b, 20000, 0, 1);
+  b.lora_task = sched.add("lora", lora_task, &b, 0);
+  sched.signal(b.lora_task);
+
+  while (hal_millis() - b.start_ms < (uint32_t)minutes * 60000) {
+    if (!sched.runOnce()) hal_delay_us(sched.idle());
+  }
+
+  double total_s = (hal_millis() - b.start_ms) / 1000.0;
+  double hour = radio.maxDuty(3600ULL * 1000000000);
+  double accounted = reporter.airtime_us / 1e6, measured = radio.on_air_ns / 1e9;
+  uint32_t pose_frames = reporter.encoder.keys + reporter.encoder.deltas;
+  printf("lora       %d min at SF%d/%u kHz: %u frames (%u keys, %u deltas, %u tags), %.1f bytes/frame\n",
+         minutes, LORA_BENCH_SF, LORA_BENCH_BW / 1000, reporter.frames, reporter.encoder.keys,
+         reporter.encoder.deltas, reporter.encoder.tags, (double)reporter.bytes / reporter.frames);
+  printf("           airtime %.2f s accounted, %.2f s on the air; duty %.3f%% overall, %.3f%% max in any hour\n",
+         accounted, measured, 100 * measured / total_s, 100 * hour);
+  printf("           %u poses coalesced, %u deferred for airtime, %u radio busy, tag wait max %u ms, %u tags dropped\n",
+         reporter.coalesced, reporter.deferred, reporter.busy, reporter.tag_wait_max_ms, reporter.tags_dropped);
+  printf("           received %u of %u (%u lost, %u deltas without key), %u tags; position error avg %.1f cm, max %.1f cm\n",
+         b.received, reporter.frames, radio.lost, decoder.no_key, b.tags,
+         b.received > b.tags ? b.err_sum_cm / (b.received - b.tags) : 0.0, b.err_max_cm);
+  bool ok = hour <= 0.01 && fabs(accounted - measured) < 0.001 * measured + 0.001 &&
+            pose_frames > 0 && reporter.tags_dropped == 0 &&
+            decoder.no_key * 5 < reporter.encoder.deltas;
+  return ok ? 0 : 1;
+}
+
+// a recorded trace, as written by the fusion command, through the fusion
+static int run_replay(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "can't open %s\n", path);
+    return 1;
+  }
+  char line[96];
+  int n = 0;
+  while (n < FUSION_MAX_TRACE && fgets(line, sizeof(line), f)) {
+    TraceRow &r = trace[n];
+    int dx, dy;
+    unsigned squal, flags;
+    if (sscanf(line, "%d,%d,%u,%d,%d,%u,%u", &r.batch, &r.sensor, &r.s.t_us, &dx, &dy,
+               &squal, &flags) != 7 || r.sensor < 0 || r.sensor > 1)
+      continue;
+    r.s.dx = dx;
+    r.s.dy = dy;
+    r.s.squal = squal;
+    r.s.flags = flags;
+    ++n;
+  }
+  fclose(f);
+
+  FlowFusion fused;
+  PoseTracker pose;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  fusion_run(*fusion_setup(fused), pose, trace, n);
+  double ns = elapsed_ns(t0, fused.batches ? fused.batches : 1);
+  const Pose &p = pose.pose();
+  printf("replay     %d rows, %u batches: x %.1f mm, y %.1f mm, heading %.2f deg, path %.1f mm\n",
+         n, fused.batches, p.x_um / 1000.0, p.y_um / 1000.0, FUSION_DEG(p.heading),
+         p.path_um / 1000.0);
+  printf("           %u rejected, %u low quality, %u saturated, %u batches without rotation, %.1f ns per batch\n",
+         fused.rejected, fused.low_quality, fused.saturated, fused.no_rotation, ns);
+  return 0;
+}
+
+// binary telemetry capture back to CSV, one header comment per record type
+static int run_decode(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "can't open %s\n", path);
+    return 1;
+  }
+
+  TelemetryDecoder dec;
+  TelemetryRecord r;
+  bool header[256] = { false };
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    if (!dec.push(c, r)) continue;
+    const TlmSchema *schema = tlm_schema(r.type);
+    if (!header[r.type]) {
+      printf("# %s: t_us,%s%s\n", schema->name, schema->columns, schema->blob ? ",data" : "");
+      header[r.type] = true;
+    }
+    if (r.time_valid) printf("%u", r.t_us);
+    for (int i = 0; i < r.num_fields; ++i) printf(",%d", r.fields[i]);
+    if (r.type == TLM_FRAME_RLE) {
+      uint8_t pixels[FRAME_PIXELS];
+      putchar(',');
+      if (frame_decode(r.blob, r.blob_len, pixels))
+        for (int i = 0; i < FRAME_PIXELS; ++i) printf("%02x", pixels[i]);
+    } else if (schema->blob) {
+      putchar(',');
+      for (int i = 0; i < r.blob_len; ++i) printf("%02x", r.blob[i]);
+    }
+    putchar('\n');
+  }
+  fclose(f);
+
+  fprintf(stderr, "decode     %u frames, %u crc errors, %u unknown, %u bytes skipped\n",
+          dec.frames, dec.crc_errors, dec.unknown, dec.skipped);
+  return dec.crc_errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+  const char *cmd = argc > 1 ? argv[1] : "all";
+  int samples = argc > 2 ? atoi(argv[2]) : 1000;
+
+  sim_bus().gpio_cost_ns = ESP32_GPIO_NS;
+  sim_bus().fast_cost_ns = ESP32_GPIO_REG_NS;
+
+  if (strcmp(cmd, "mouse") == 0) return run_mouse(samples);
+  if (strcmp(cmd, "cam") == 0) return run_cam(samples);
+  if (strcmp(cmd, "fast") == 0) return run_fast(samples);
+  if (strcmp(cmd, "ring") == 0) return run_ring(samples);
+  if (strcmp(cmd, "sampler") == 0) return run_sampler(samples);
+  if (strcmp(cmd, "odometry") == 0) return run_odometry(samples);
+  if (strcmp(cmd, "adaptive") == 0) return run_adaptive(samples);
+  if (strcmp(cmd, "cpi") == 0) return run_cpi(samples);
+  if (strcmp(cmd, "txn") == 0) return run_txn(samples);
+  if (strcmp(cmd, "framediff") == 0) return run_framediff(samples);
+  if (strcmp(cmd, "display") == 0) return run_display(samples);
+  if (strcmp(cmd, "tags") == 0) return run_tags(samples);
+  if (strcmp(cmd, "sched") == 0) return run_sched(samples);
+  if (strcmp(cmd, "profile") == 0) return run_profile(samples);
+  if (strcmp(cmd, "telemetry") == 0) return run_telemetry(samples);
+  if (strcmp(cmd, "frames") == 0) return run_frames(samples);
+  if (strcmp(cmd, "sensors") == 0) return run_sensors(samples);
+  if (strcmp(cmd, "pose") == 0) return run_pose(samples);
+  if (strcmp(cmd, "power") == 0) return run_power(argc > 2 ? samples : 10);
+  if (strcmp(cmd, "startup") == 0) return run_startup(argc > 2 ? samples : 3000);
+  if (strcmp(cmd, "udp") == 0) return run_udp(argc > 2 ? samples : 600);
+  if (strcmp(cmd, "lora") == 0) return run_lora(argc > 2 ? samples : 180);
+  if (strcmp(cmd, "fusion") == 0) return run_fusion(samples, argc > 3 ? argv[3] : NULL);
+  if (strcmp(cmd, "replay") == 0 && argc > 2) return run_replay(argv[2]);
+  if (strcmp(cmd, "decode") == 0 && argc > 2) return run_decode(argv[2]);
+  if (strcmp(cmd, "all") == 0) {
+    run_mouse(samples);
+    run_cam(samples);
+    return run_fast(samples);
+  }
+
+  fprintf(stderr, "usage: %s [all|mouse|cam|fast|ring|sampler|odometry|adaptive|cpi|txn|framediff|display|tags|sched|profile|telemetry|frames|sensors|pose|power] [samples]\n"
+                  "       %s startup [wifi ms]\n"
+                  "       %s udp [seconds]\n"
+                  "       %s lora [minutes]\n"
+                  "       %s fusion [batches] [trace.csv]\n"
+                  "       %s replay <trace.csv>\n"
+                  "       %s decode <capture>\n", argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+  return 1;
+}
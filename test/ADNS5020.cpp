@@ -5,8 +5,7 @@
 // ----------------------------------------------------------------------------
 
 #include "ADNS5020.h"
-#include "Arduino.h"
-#include <Print.h>
+#include "hal.h"
 
 // ADNS5020 timings (microseconds)
 #define T_PD          50000 // from power down to valid motion
@@ -32,15 +31,20 @@ ADNS5020::ADNS5020(uint8_t sclk, uint8_t sdio, uint8_t ncs, uint8_t nreset, int
   _nreset = nreset;
   _cpi = cpi;
   factor = 1;
+  cpi_switches = 0;
+  control_writes = 0;
+  txn_bytes = txn_us = 0;
+  bytes_clocked = bus_us = 0;
+  transactions = merged_reads = skipped_writes = 0;
   x = 0;
   y = 0;
 
-  pinMode(_sclk, OUTPUT);
-  pinMode(_sdio, INPUT);
-  pinMode(_ncs, OUTPUT);
-  pinMode(_nreset, OUTPUT);
+  hal_pin_mode(_sclk, OUTPUT);
+  hal_pin_mode(_sdio, INPUT);
+  hal_pin_mode(_ncs, OUTPUT);
+  hal_pin_mode(_nreset, OUTPUT);
 
-  digitalWrite(_nreset, HIGH);
+  hal_write(_nreset, HIGH);
 
   disable();
 
@@ -100,6 +104,39 @@ void ADNS5020::printAll() {
   Serial.println();
 }
 
+// same capture as mousecamOutput(), as one TLM_FRAME in a single write
+void ADNS5020::mousecamTelemetry(TelemetryWriter &tlm) {
+  uint32_t t = hal_micros();
+  readDelta();
+  if (!readFrame()) return;
+
+  tlm.begin(TLM_FRAME, t);
+  tlm.putSigned(dx);
+  tlm.putSigned(dy);
+  tlm.putBytes(frame, ADNS5020_FRAME_LENGTH);
+  tlm.end();
+  tlm.flush();
+}
+
+void ADNS5020::writeDelta(TelemetryWriter &tlm, uint32_t t_us) {
+  tlm.begin(TLM_MOTION, t_us);
+  tlm.putSigned(dx);
+  tlm.putSigned(dy);
+  tlm.putUnsigned(squal);
+  tlm.end();
+}
+
+void ADNS5020::writeAll(TelemetryWriter &tlm, uint32_t t_us) {
+  tlm.begin(TLM_MOTION_ALL, t_us);
+  tlm.putSigned(dx);
+  tlm.putSigned(dy);
+  tlm.putUnsigned(squal);
+  tlm.putUnsigned((shutter_upper << 8) | shutter_lower);
+  tlm.putUnsigned(max_pixel);
+  tlm.putUnsigned(pixel_sum);
+  tlm.end();
+}
+
 void ADNS5020::printd3(int i) {
   int n = abs(i);
   if (i>=0) Serial.print(" ");
@@ -114,71 +151,221 @@ void ADNS5020::printd3(int i) {
  */
 float ADNS5020::transformDx() 
 {
-  return ((float)dx * fcos) - ((float)dy * fsin);
+  return (float)factor * (((float)dx * fcos) - ((float)dy * fsin));
 }
 
 float ADNS5020::transformDy() 
 {
-  return ((float)dx * fsin) + ((float)dy * fcos);
+  return (float)factor * (((float)dx * fsin) + ((float)dy * fcos));
 }
 
+// MOTION, then DX, DY and SQUAL - one transaction, the last three merge
+// into a burst
 void ADNS5020::readDelta()
 {
-  enable();
-  motion = readRegister(ADNS5020_REG_MOTION); // Freezes DX and DY until they are read or MOTION is read again.
-  setDelta(readRegister(ADNS5020_REG_DELTA_X), readRegister(ADNS5020_REG_DELTA_Y));
-  // dx = factor * readRegister(ADNS5020_REG_DELTA_X);
-  // dy = factor * readRegister(ADNS5020_REG_DELTA_Y);
-  squal = readRegister(ADNS5020_REG_SQUAL);
+  if (!_powered) powerUp();
+  settle();
+  uint8_t rx, ry;
+  queueRead(ADNS5020_REG_MOTION, &motion); // Freezes DX and DY until they are read or MOTION is read again.
+  queueRead(ADNS5020_REG_DELTA_X, &rx);
+  queueRead(ADNS5020_REG_DELTA_Y, &ry);
+  queueRead(ADNS5020_REG_SQUAL, &squal);
+  commit();
+  setDelta(rx, ry);
   updatePosition();
-  disable();
+  adaptResolution();
 }
 
 
 void ADNS5020::readBurst() {
-  enable();
-  motion = readRegister(ADNS5020_REG_MOTION); // Freezes DX and DY until they are read or MOTION is read again.
+  if (!_powered) powerUp();
+  settle();
+  queueRead(ADNS5020_REG_MOTION, &motion); // Freezes DX and DY until they are read or MOTION is read again.
+  commit(false);
   if (motion != 0) {
-    pushbyte(ADNS5020_REG_BURST_MODE);
-    delayMicroseconds(4); // tSRAD= 4us min.
-
-    setDelta(pullbyte(), pullbyte());
-    // dx = factor * pullbyte();
-    // dy = factor * pullbyte();
-    squal = pullbyte();
-    shutter_upper = pullbyte();
-    shutter_lower = pullbyte();
-    max_pixel = pullbyte();
-    pixel_sum = pullbyte();
-
+    uint8_t rx, ry;
+    queueRead(ADNS5020_REG_DELTA_X, &rx);
+    queueRead(ADNS5020_REG_DELTA_Y, &ry);
+    queueRead(ADNS5020_REG_SQUAL, &squal);
+    queueRead(ADNS5020_REG_SHUTTER_UPPER, &shutter_upper);
+    queueRead(ADNS5020_REG_SHUTTER_LOWER, &shutter_lower);
+    queueRead(ADNS5020_REG_MAX_PIXEL, &max_pixel);
+    queueRead(ADNS5020_REG_PIXEL_SUM, &pixel_sum);
+    commit();
+    setDelta(rx, ry);
     updatePosition();
   } else {
     dx = dy = squal = 0;
+    disable();
   }
-  disable();
-  delayMicroseconds(1); // tBEXIT= 250ns min.
+  adaptResolution();
+}
+
+
+void ADNS5020::queueRead(uint8_t address, uint8_t *out) {
+  if (_queued == ADNS5020_QUEUE) commit(false);
+  Access &a = _queue[_queued++];
+  a.address = address & 0x7f;
+  a.out = out;
+}
+
+void ADNS5020::queueWrite(uint8_t address, uint8_t value) {
+  if (_queued == ADNS5020_QUEUE) commit(false);
+  Access &a = _queue[_queued++];
+  a.address = address | 0x80;
+  a.value = value;
+  a.out = NULL;
+}
+
+// position of a register in the burst, -1 if not in it
+int ADNS5020::burstIndex(uint8_t address) const {
+  if (address < ADNS5020_REG_DELTA_X || address > ADNS5020_REG_PIXEL_SUM) return -1;
+  return address - ADNS5020_REG_DELTA_X;
+}
+
+void ADNS5020::shadow(uint8_t address, uint8_t value) {
+  if (address == ADNS5020_REG_CHIP_RESET) {
+    _shadow_valid = 0;
+    shadow(ADNS5020_REG_CONTROL, 0); // cleared by the reset
+  } else if (ADNS5020_SHADOWED & (1ULL << address)) {
+    _shadow[address] = value;
+    _shadow_valid |= 1ULL << address;
+  }
+}
+
+void ADNS5020::commit(bool release) {
+  uint32_t t0 = hal_micros();
+  uint32_t bytes0 = bytes_clocked;
+
+  // a burst costs the address and the bytes up to the last one wanted,
+  // single reads two bytes each
+  int reads = 0, last = -1;
+  for (int i = 0; i < _queued; ++i) {
+    int k = (_queue[i].address & 0x80) ? -1 : burstIndex(_queue[i].address);
+    if (k < 0) continue;
+    ++reads;
+    if (k > last) last = k;
+  }
+  bool burst = reads >= 2 && last + 2 < 2 * reads;
+  bool burst_done = false;
+
+  for (int i = 0; i < _queued; ++i) {
+    Access &a = _queue[i];
+    uint8_t address = a.address & 0x7f;
+
+    if (a.address & 0x80) {
+      if ((_shadow_valid & (1ULL << address)) && _shadow[address] == a.value) {
+        ++skipped_writes;
+        continue;
+      }
+      enable();
+      writeRegister(address, a.value);
+      shadow(address, a.value);
+      if (address == ADNS5020_REG_CONTROL) ++control_writes;
+      continue;
+    }
+
+    if (!burst || burstIndex(address) < 0) {
+      enable();
+      *a.out = readRegister(address);
+      shadow(address, *a.out);
+      continue;
+    }
+
+    if (burst_done) continue;
+
+    // the first burst register: read them all, the burst ends with NCS
+    enable();
+    pushbyte(ADNS5020_REG_BURST_MODE);
+    hal_delay_us(T_SRAD);
+    uint8_t data[ADNS5020_REG_PIXEL_SUM - ADNS5020_REG_DELTA_X + 1];
+    for (int k = 0; k <= last; ++k) data[k] = pullbyte();
+    disable();
+    hal_delay_us(T_BEXIT); // tBEXIT= 250ns min.
+    for (int j = i; j < _queued; ++j) {
+      int k = (_queue[j].address & 0x80) ? -1 : burstIndex(_queue[j].address);
+      if (k < 0) continue;
+      *_queue[j].out = data[k];
+    }
+    merged_reads += reads - 1;
+    burst_done = true;
+  }
+
+  _queued = 0;
+  if (release) disable();
+  txn_bytes = bytes_clocked - bytes0;
+  txn_us = hal_micros() - t0;
+  bus_us += txn_us;
+  ++transactions;
 }
 
 
 void ADNS5020::updatePosition() {
   if (motion != 0) {
-    x += dx;
-    y += dy;
+    x += factor * dx;
+    y += factor * dy;
   }
 }
 
 
-void ADNS5020::readFrame() {
+/**
+ * Pick the resolution for the next sample. Called after a complete read,
+ * so the chip has no pending counts at the old resolution.
+ */
+void ADNS5020::adaptResolution() {
+  if (!_auto_cpi) return;
+
+  int ax = abs(dx);
+  int ay = abs(dy);
+  int peak = ax > ay ? ax : ay;
+  if (_cpi == 1000) {
+    if (peak >= _cpi_down) {
+      resolution(500);
+      ++cpi_switches;
+    }
+  } else {
+    _slow_samples = (peak < _cpi_up) ? _slow_samples + 1 : 0;
+    if (_slow_samples >= _cpi_up_samples) {
+      resolution(1000);
+      ++cpi_switches;
+    }
+  }
+}
+
+void ADNS5020::autoResolution(bool on, int down_counts, int up_counts, int up_samples) {
+  _auto_cpi = on;
+  _cpi_down = down_counts;
+  _cpi_up = up_counts;
+  _cpi_up_samples = up_samples;
+  _slow_samples = 0;
+}
+
+
+bool ADNS5020::readFrame() {
+  return grabFrame(frame);
+}
+
+
+/**
+ * Pixel dump, first pixel top left. Bit 7 of PIXEL_GRAB tells if the
+ * byte is a pixel: the first one is only ready a frame period after the
+ * grab starts, so reads without it are repeated, not stored.
+ */
+bool ADNS5020::grabFrame(uint8_t *pixels) {
+  enable(); // readDelta() before may have released NCS
   writeRegister(ADNS5020_REG_PIXEL_GRAB, 1);
   int count = 0;
+  int retries = 0;
   do {
     uint8_t data = readRegister(ADNS5020_REG_PIXEL_GRAB);
-    //if( (data & 0x80) == 0 ) // Data is valid
-    {
-      frame[count++] = data & 0x7f;
-    }
+    if (data & 0x80) // Data is valid
+      pixels[count++] = data & 0x7f;
+    else if (++retries > ADNS5020_GRAB_RETRIES)
+      break;
   }
   while (count != ADNS5020_FRAME_LENGTH);
+  disable();
+  return count == ADNS5020_FRAME_LENGTH;
 }
 
 
@@ -203,6 +390,7 @@ void ADNS5020::reset() {
     softReset();
   else
     hardReset();
+  shadow(ADNS5020_REG_CHIP_RESET, 0); // CONTROL is cleared by the reset
 
   // Set resolution 
   resolution(_cpi);
@@ -214,11 +402,12 @@ void ADNS5020::reset() {
  * set CHIP SELECT
  */
 void ADNS5020::enable() {
+  if (_selected) return;
+  _selected = true;
   if (_ncs >= 0) {
-    digitalWrite(_ncs, LOW);    
-    delayMicroseconds(T_NCS_SCLK);
+    hal_write(_ncs, LOW);    
+    hal_delay_us(T_NCS_SCLK);
   }
-  if (!_powered) powerUp();
 }
 
 
@@ -227,67 +416,88 @@ void ADNS5020::enable() {
  * SDIO is in high-Z (floating) when disabled (NCS=high)
  */
 void ADNS5020::disable() {
+  _selected = false;
   if (_ncs >= 0) {
-    digitalWrite(_ncs, HIGH);
-    delayMicroseconds(T_SCLK_NSC_R);
-    delayMicroseconds(T_NCS_SDIO);
+    hal_write(_ncs, HIGH);
+    hal_delay_us(T_SCLK_NSC_R);
+    hal_delay_us(T_NCS_SDIO);
   }
 }
 
 void ADNS5020::softReset() {
   writeRegister(ADNS5020_REG_CHIP_RESET, 0x5a);
-  delay(55); // t_WAKEUP=55ms
+  hal_delay_ms(55); // t_WAKEUP=55ms
 }
 
 
 void ADNS5020::hardReset() {
-  digitalWrite(_nreset, LOW);
-  delayMicroseconds(T_PD); 
-  digitalWrite(_nreset, HIGH);
-  delayMicroseconds(T_WAKEUP); 
+  hal_write(_nreset, LOW);
+  hal_delay_us(T_PD); 
+  hal_write(_nreset, HIGH);
+  hal_delay_us(T_WAKEUP); 
 }
 
+// the resolution bit is kept, so waking up is a single CONTROL write
 void ADNS5020::powerDown() {
-  if (_powered) {
-    enable();
-    writeRegister(ADNS5020_REG_CONTROL, 0b00000010);
-    disable();
-  }
   _powered = false;
+  writeControl((_cpi == 1000 ? 0b00000001 : 0) | 0b00000010);
 }
 
+// does not wait: the first motion read does if it comes before tPD
 void ADNS5020::powerUp() {
+  if (_powered) return;
   _powered = true;
-  reset();
+  writeControl(_cpi == 1000 ? 0b00000001 : 0);
+  _waking = true;
+  _wake_us = hal_micros();
+}
+
+void ADNS5020::settle() {
+  if (!_waking) return;
+  uint32_t since = hal_micros() - _wake_us;
+  if (since < T_PD) hal_delay_us(T_PD - since);
+  _waking = false;
 }
 
 
 void ADNS5020::resolution(int cpi) {
-  enable();
   _cpi = cpi;
+  _slow_samples = 0;
+  uint8_t pd = _powered ? 0 : 0b00000010;
   if (_cpi == 1000) {
-    writeRegister(ADNS5020_REG_CONTROL, 0b00000001);
+    factor = 1;
+    writeControl(0b00000001 | pd);
   }
   else {
-    writeRegister(ADNS5020_REG_CONTROL, 0b00000000);
+    factor = 2;
+    writeControl(0b00000000 | pd);
   }
-  disable();
+}
+
+
+/**
+ * write CONTROL unless the shadow copy says it already has this value
+ */
+void ADNS5020::writeControl(uint8_t value) {
+  queueWrite(ADNS5020_REG_CONTROL, value);
+  commit();
 }
 
 
 byte ADNS5020::pullbyte() { 
-  pinMode(_sdio, INPUT);
+  hal_pin_mode(_sdio, INPUT);
+  ++bytes_clocked;
 
   byte res = 0;
   for (byte i = 128; i > 0 ; i >>= 1) {
-    digitalWrite(_sclk, LOW); // sensor outputs on falling edge
-    delayMicroseconds(T_DLY_SDIO); // wait for data ready
-    res |= i * digitalRead(_sdio);
-    digitalWrite(_sclk, HIGH);
-    delayMicroseconds(T_HOLD); //x - 0.5us HOLD
+    hal_write(_sclk, LOW); // sensor outputs on falling edge
+    hal_delay_us(T_DLY_SDIO); // wait for data ready
+    res |= i * hal_read(_sdio);
+    hal_write(_sclk, HIGH);
+    hal_delay_us(T_HOLD); //x - 0.5us HOLD
   }
 
-  delayMicroseconds(T_SRX);
+  hal_delay_us(T_SRX);
 
   return res;
 }
@@ -296,22 +506,24 @@ byte ADNS5020::pullbyte() {
 
 void ADNS5020::pushbyte(byte data) {
 
-  pinMode (_sdio, OUTPUT);
+  hal_pin_mode(_sdio, OUTPUT);
+  ++bytes_clocked;
 
   for (byte i = 128; i > 0 ; i >>= 1) {
-    digitalWrite(_sclk, LOW);
-    digitalWrite(_sdio, (data & i) != 0 ? HIGH : LOW);
-    delayMicroseconds(T_SETUP); 
-    digitalWrite(_sclk, HIGH); // sensor reads on rising clock
-    delayMicroseconds(T_HOLD); 
+    hal_write(_sclk, LOW);
+    hal_write(_sdio, (data & i) != 0 ? HIGH : LOW);
+    hal_delay_us(T_SETUP); 
+    hal_write(_sclk, HIGH); // sensor reads on rising clock
+    hal_delay_us(T_HOLD); 
   }
-  pinMode(_sdio, INPUT);
+  hal_pin_mode(_sdio, INPUT);
 }
 
 
 uint8_t ADNS5020::readRegister(uint8_t address) {
   address &= 0x7F; // MSB indicates read mode: 0
   pushbyte(address);
+  hal_delay_us(T_SRAD);
   uint8_t data = pullbyte();
   return data;
 }
@@ -321,8 +533,8 @@ void ADNS5020::writeRegister(uint8_t address, uint8_t data) {
   address |= 0x80; // MSB indicates write mode: 1
 
   pushbyte(address);
-  delayMicroseconds(ADNS5020_DELAY);
+  hal_delay_us(ADNS5020_DELAY);
 
   pushbyte(data);
-  delayMicroseconds(ADNS5020_DELAY); // tSWW, tSWR = 100us min.
+  hal_delay_us(ADNS5020_DELAY); // tSWW, tSWR = 100us min.
 }
@@ -7,7 +7,9 @@
 #ifndef __ADNS5020_H__
 #define __ADNS5020_H__
 
-#include "Arduino.h"
+#include "hal.h"
+#include "Telemetry.h"
+#include "FlowSensor.h"
 
 #define ADNS5020_REG_PRODUCT_ID     0x00
 #define ADNS5020_REG_REVISION_ID    0x01
@@ -15,6 +17,10 @@
 #define ADNS5020_REG_DELTA_X        0x03
 #define ADNS5020_REG_DELTA_Y        0x04
 #define ADNS5020_REG_SQUAL          0x05
+#define ADNS5020_REG_SHUTTER_UPPER  0x06
+#define ADNS5020_REG_SHUTTER_LOWER  0x07
+#define ADNS5020_REG_MAX_PIXEL      0x08
+#define ADNS5020_REG_PIXEL_SUM      0x09
 #define ADNS5020_REG_BURST_MODE     0x63
 #define ADNS5020_REG_CONTROL        0x0d
 #define ADNS5020_REG_PIXEL_GRAB     0x0b
@@ -22,12 +28,16 @@
 
 #define ADNS5020_FRAME_LENGTH       225
 #define ADNS5020_DELAY              10
+#define ADNS5020_GRAB_RETRIES       1000 // pixel reads without the valid bit before giving up
+#define ADNS5020_QUEUE              16   // register accesses per transaction
+#define ADNS5020_REGISTERS          0x40
+#define ADNS5020_SHADOWED           (1ULL << ADNS5020_REG_CONTROL) // registers that keep what was written
 
 // Avago ADNS-5020-EN optical mouse sensor
 // see http://strofoland.com/arduino-projects/reading-a5020-optical-sensor-using-arduino-part2/
 // see https://www.bidouille.org/hack/mousecam
 
-class ADNS5020 {
+class ADNS5020 : public FlowSensor<ADNS5020> {
   public:
     ADNS5020(uint8_t sclk, uint8_t sdio, uint8_t ncs, uint8_t nreset, int cpi);
 
@@ -52,6 +62,8 @@ class ADNS5020 {
     byte frame[ADNS5020_FRAME_LENGTH];
 
 
+    // counts per register count: x/y and the transforms are always in
+    // 1000 CPI units, whatever the current resolution
     int factor;
     int x;
     int y;
@@ -74,15 +86,59 @@ class ADNS5020 {
     float transformDy();
 
     void resolution(int cpi);
+    int cpi() const { return _cpi; }
+
+    // switch CPI on the fly: drop to 500 CPI when a delta reaches down_counts
+    // at 1000 CPI, return to 1000 CPI after up_samples deltas in a row below
+    // up_counts at 500 CPI
+    void autoResolution(bool on, int down_counts = 64, int up_counts = 16, int up_samples = 8);
+    uint32_t cpi_switches;
+    uint32_t control_writes; // CONTROL writes that actually went to the chip
     void identify();
     void readDelta();
     void readBurst();
-    void readFrame();
+
+    // Register transactions: queue reads and writes, commit() clocks them
+    // in one chip select. Reads of two or more motion registers become a
+    // single burst read when that is fewer bytes (the burst ends the chip
+    // select, later accesses select again). Writes to a shadowed register
+    // that already holds the value are skipped.
+    void queueRead(uint8_t address, uint8_t *out);
+    void queueWrite(uint8_t address, uint8_t value);
+    void commit(bool release = true);   // false: keep NCS low for the next one
+
+    // bus statistics, last commit and totals
+    uint32_t txn_bytes;
+    uint32_t txn_us;
+    uint32_t bytes_clocked;
+    uint32_t bus_us;
+    uint32_t transactions;
+    uint32_t merged_reads;            // reads saved by bursts
+    uint32_t skipped_writes;          // writes the shadow made unnecessary
+    bool readFrame();                 // into frame[]
+
+    // FlowSensor: a burst read, deltas in 1000 CPI counts. The counts were
+    // taken at the resolution before readBurst() may switch it.
+    bool readSample(MotionSample &s) {
+      int f = factor;
+      readBurst();
+      s.dx = f * dx;
+      s.dy = f * dy;
+      s.squal = squal;
+      s.flags = saturation_flags(dx, dy) | ((motion & 0x80) ? SAMPLE_MOTION : 0);
+      return true;
+    }
+    bool grabFrame(uint8_t *pixels);  // into any buffer of ADNS5020_FRAME_LENGTH
     void mousecamOutput();
     void printDelta();
     void printAll();
     void printShort();
 
+    // binary counterparts of the print functions, see Telemetry.h
+    void mousecamTelemetry(TelemetryWriter &tlm);
+    void writeDelta(TelemetryWriter &tlm, uint32_t t_us);
+    void writeAll(TelemetryWriter &tlm, uint32_t t_us);
+
     
   private:   
     uint8_t _sclk;
@@ -92,9 +148,30 @@ class ADNS5020 {
     int _cpi;
 
     bool _powered = true;
-
-    void enable();  // NCS=high
-    void disable(); // NCS=low
+    bool _selected = false;
+    bool _waking = false;     // powered up, motion not valid before tPD
+    uint32_t _wake_us;
+
+    // what the chip holds in the ADNS5020_SHADOWED registers
+    uint8_t _shadow[ADNS5020_REGISTERS];
+    uint64_t _shadow_valid = 0;
+
+    struct Access {
+      uint8_t address;        // MSB set: write
+      uint8_t value;
+      uint8_t *out;
+    };
+    Access _queue[ADNS5020_QUEUE];
+    int _queued = 0;
+
+    bool _auto_cpi = false;
+    int _cpi_down;
+    int _cpi_up;
+    int _cpi_up_samples;
+    int _slow_samples;
+
+    void enable();  // NCS=low
+    void disable(); // NCS=high
 
     void setDelta(int8_t rx, int8_t ry) {
       dx = rx;
@@ -107,6 +184,11 @@ class ADNS5020 {
     void writeRegister(uint8_t address, uint8_t data);
     void printd3(int i);
     void updatePosition();
+    void writeControl(uint8_t value);
+    void settle();
+    void shadow(uint8_t address, uint8_t value);
+    int burstIndex(uint8_t address) const;
+    void adaptResolution();
   
 };
 
@@ -0,0 +1,228 @@
+// ----------------------------------------------------------------------------
+// A&O MECANUMROVER
+// Rover-2 Odometer, ADNS-5020 driver specialized on pins and timing
+// ----------------------------------------------------------------------------
+
+#ifndef __ADNS5020FAST_H__
+#define __ADNS5020FAST_H__
+
+#include "hal.h"
+#include "ADNS5020.h"
+
+#define ADNS5020_NO_PIN 0xff
+
+// ADNS-5020 serial port timing (ns), the datasheet values behind the
+// rounded-up T_* microsecond defines in ADNS5020.cpp
+struct ADNS5020Timing {
+  static const uint32_t clk_low_ns = 500;     // tSCLK-low, covers tDLY-SDIO 120ns
+  static const uint32_t clk_high_ns = 500;    // tSCLK-high, covers tHOLD
+  static const uint32_t setup_ns = 120;       // tSETUP
+  static const uint32_t ncs_sclk_ns = 120;    // tNCS-SCLK
+  static const uint32_t sclk_ncs_r_ns = 120;  // tSCLK-NCS (read)
+  static const uint32_t sclk_ncs_w_ns = 20000; // tSCLK-NCS (write)
+  static const uint32_t ncs_sdio_ns = 500;    // tNCS-SDIO
+  static const uint32_t srad_ns = 4000;       // tSRAD
+  static const uint32_t srx_ns = 500;         // tSRR, tSRW
+  static const uint32_t sww_ns = 30000;       // tSWW
+  static const uint32_t swr_ns = 20000;       // tSWR
+  static const uint32_t bexit_ns = 250;       // tBEXIT
+};
+
+// The hot path of ADNS5020 (delta, burst and frame reads) with SCLK/SDIO/NCS
+// as template parameters, so pin accesses compile to GPIO register stores
+// and the gaps are cycle-counted. NRESET is driven once in init().
+template <uint8_t SCLK, uint8_t SDIO, uint8_t NCS,
+          uint8_t NRESET = ADNS5020_NO_PIN, class T = ADNS5020Timing>
+class ADNS5020Fast : public FlowSensor<ADNS5020Fast<SCLK, SDIO, NCS, NRESET, T> > {
+  public:
+    byte motion; // motion flag is in MSB(!)
+    int8_t dx;
+    int8_t dy;
+    byte squal;
+    byte shutter_upper;
+    byte shutter_lower;
+    byte max_pixel;
+    byte pixel_sum;
+    byte frame[ADNS5020_FRAME_LENGTH];
+
+    // counts per register count: x/y and samples are in 1000 CPI units,
+    // whatever resolution CONTROL is set to
+    int factor;
+    int x;
+    int y;
+
+    ADNS5020Fast() : motion(0), dx(0), dy(0), squal(0), factor(1), x(0), y(0) {}
+
+    void init(int cpi) {
+      hal_pin_mode(SCLK, OUTPUT);
+      hal_write(SCLK, HIGH);
+      hal_pin_mode(SDIO, INPUT);
+      if (NCS != ADNS5020_NO_PIN) {
+        hal_pin_mode(NCS, OUTPUT);
+        hal_write(NCS, HIGH);
+      }
+      if (NRESET != ADNS5020_NO_PIN) {
+        hal_pin_mode(NRESET, OUTPUT);
+        hal_write(NRESET, LOW);
+        hal_delay_us(T_PD_US);
+        hal_write(NRESET, HIGH);
+      } else {
+        enable();
+        writeRegister(ADNS5020_REG_CHIP_RESET, 0x5a);
+        disable();
+      }
+      hal_delay_us(T_WAKEUP_US);
+      resolution(cpi);
+    }
+
+    void resolution(int cpi) {
+      factor = cpi == 1000 ? 1 : 2;
+      enable();
+      writeRegister(ADNS5020_REG_CONTROL, cpi == 1000 ? 0b00000001 : 0b00000000);
+      disable();
+    }
+
+    byte productId() {
+      enable();
+      byte id = readRegister(ADNS5020_REG_PRODUCT_ID);
+      disable();
+      return id;
+    }
+
+    void readDelta() {
+      enable();
+      motion = readRegister(ADNS5020_REG_MOTION); // freezes DX and DY
+      dx = readRegister(ADNS5020_REG_DELTA_X);
+      dy = readRegister(ADNS5020_REG_DELTA_Y);
+      squal = readRegister(ADNS5020_REG_SQUAL);
+      updatePosition();
+      disable();
+    }
+
+    void readBurst() {
+      enable();
+      motion = readRegister(ADNS5020_REG_MOTION); // freezes DX and DY
+      if (motion != 0) {
+        pushbyte(ADNS5020_REG_BURST_MODE);
+        delay(T::srad_ns);
+        dx = pullbyte();
+        dy = pullbyte();
+        squal = pullbyte();
+        shutter_upper = pullbyte();
+        shutter_lower = pullbyte();
+        max_pixel = pullbyte();
+        pixel_sum = pullbyte();
+        updatePosition();
+      } else {
+        dx = dy = squal = 0;
+      }
+      disable();
+      delay(T::bexit_ns);
+    }
+
+    bool readFrame() { return grabFrame(frame); }
+
+    // FlowSensor: a burst read, deltas in 1000 CPI counts
+    bool readSample(MotionSample &s) {
+      readBurst();
+      s.dx = factor * dx;
+      s.dy = factor * dy;
+      s.squal = squal;
+      s.flags = saturation_flags(dx, dy) | ((motion & 0x80) ? SAMPLE_MOTION : 0);
+      return true;
+    }
+
+    // pixels without the valid bit are read again, not stored
+    bool grabFrame(uint8_t *pixels) {
+      enable();
+      writeRegister(ADNS5020_REG_PIXEL_GRAB, 1);
+      int retries = 0;
+      for (int i = 0; i < ADNS5020_FRAME_LENGTH; ) {
+        byte data = readRegister(ADNS5020_REG_PIXEL_GRAB);
+        if (data & 0x80) {
+          pixels[i++] = data & 0x7f;
+        } else if (++retries > ADNS5020_GRAB_RETRIES) {
+          disable();
+          return false;
+        }
+      }
+      disable();
+      return true;
+    }
+
+  private:
+    typedef HalPin<SCLK> Sclk;
+    typedef HalPin<SDIO> Sdio;
+    typedef HalPin<NCS> Ncs;
+
+    static const uint32_t T_PD_US = 50000;
+    static const uint32_t T_WAKEUP_US = 55000;
+
+    static inline void delay(uint32_t ns) {
+      if (ns >= 10000) hal_delay_us(ns / 1000);
+      else hal_delay_ns(ns);
+    }
+
+    void enable() {
+      if (NCS == ADNS5020_NO_PIN) return;
+      Ncs::low();
+      delay(T::ncs_sclk_ns);
+    }
+
+    void disable() {
+      if (NCS == ADNS5020_NO_PIN) return;
+      delay(T::sclk_ncs_r_ns);
+      Ncs::high();
+      delay(T::ncs_sdio_ns);
+    }
+
+    void updatePosition() {
+      if (motion != 0) {
+        x += factor * dx;
+        y += factor * dy;
+      }
+    }
+
+    // the sensor reads on the rising clock
+    void pushbyte(byte data) {
+      Sdio::output();
+      for (byte mask = 0x80; mask; mask >>= 1) {
+        Sclk::low();
+        Sdio::write(data & mask);
+        delay(T::clk_low_ns);
+        Sclk::high();
+        delay(T::clk_high_ns);
+      }
+      Sdio::input();
+    }
+
+    // the sensor outputs on the falling clock
+    byte pullbyte() {
+      byte res = 0;
+      for (byte mask = 0x80; mask; mask >>= 1) {
+        Sclk::low();
+        delay(T::clk_low_ns);
+        if (Sdio::read()) res |= mask;
+        Sclk::high();
+        delay(T::clk_high_ns);
+      }
+      return res;
+    }
+
+    byte readRegister(byte address) {
+      pushbyte(address & 0x7f); // MSB indicates read mode: 0
+      delay(T::srad_ns);
+      byte data = pullbyte();
+      delay(T::srx_ns);
+      return data;
+    }
+
+    // tSWW covers a following read (tSWR) as well
+    void writeRegister(byte address, byte data) {
+      pushbyte(address | 0x80); // MSB indicates write mode: 1
+      pushbyte(data);
+      delay(T::sww_ns);
+    }
+};
+
+#endif  // __ADNS5020FAST_H__